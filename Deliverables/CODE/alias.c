@@ -0,0 +1,229 @@
+/******************************************************************************
+ * File: alias.c
+ *
+ * Purpose:
+ * Vose's construction of the alias tables in alias.h and the shared cache
+ * they are kept in.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "alias.h"
+#include "truncnorm.h"
+
+// Words drawn per pass of alias_fill
+#define ALIAS_BLOCK 512
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static alias_table_t **cache;
+static size_t cache_len, cache_cap;
+static uint64_t cache_tick; // Bumped on every lookup, for the least recently used
+
+// Mass of the standardised interval [a, b], taken from the nearer tail so
+// that far-out intervals do not cancel to zero
+static double interval_mass(double a, double b) {
+    if (a > 0) {
+        return normal_cdf(-a) - normal_cdf(-b);
+    }
+    return normal_cdf(b) - normal_cdf(a);
+}
+
+static void alias_free(alias_table_t *t) {
+    if (t != NULL) {
+        free(t->prob);
+        free(t->alias);
+        free(t);
+    }
+}
+
+// Vose: pair every under-full column with an over-full donor. q holds the
+// column masses scaled to average 1 and is used up; small/large are scratch.
+static void alias_pair(alias_table_t *t, double *q, uint32_t *small, uint32_t *large) {
+    uint32_t ns = 0, nl = 0;
+    for (uint32_t i = 0; i < t->size; i++) {
+        if (q[i] < 1) {
+            small[ns++] = i;
+        } else {
+            large[nl++] = i;
+        }
+    }
+    while (ns > 0 && nl > 0) {
+        uint32_t s = small[--ns], l = large[--nl];
+        t->prob[s] = q[s] <= 0 ? 0 : (uint64_t)ldexp(q[s], 64);
+        t->alias[s] = (int32_t)l;
+        q[l] = (q[l] + q[s]) - 1;
+        if (q[l] < 1) {
+            small[ns++] = l;
+        } else {
+            large[nl++] = l;
+        }
+    }
+    // What is left is full up to rounding: always keep the column
+    while (ns > 0) {
+        uint32_t s = small[--ns];
+        t->prob[s] = UINT64_MAX;
+        t->alias[s] = (int32_t)s;
+    }
+    while (nl > 0) {
+        uint32_t l = large[--nl];
+        t->prob[l] = UINT64_MAX;
+        t->alias[l] = (int32_t)l;
+    }
+}
+
+// Tabulate round(N(mu, sigma)) over [min, max]; NULL if it has no mass
+static alias_table_t *alias_build(double mu, double sigma, int min, int max) {
+    uint32_t size = (uint32_t)((int64_t)max - min + 1);
+    alias_table_t *t = calloc(1, sizeof *t);
+    double *q = malloc(size * sizeof(double));
+    uint32_t *small = malloc(size * sizeof(uint32_t));
+    uint32_t *large = malloc(size * sizeof(uint32_t));
+    if (t != NULL) {
+        t->prob = malloc(size * sizeof(uint64_t));
+        t->alias = malloc(size * sizeof(int32_t));
+    }
+
+    if (t != NULL && q != NULL && small != NULL && large != NULL && t->prob != NULL && t->alias != NULL) {
+        t->mu = mu;
+        t->sigma = sigma;
+        t->min = min;
+        t->max = max;
+        t->size = size;
+
+        // Value k collects the mass of [k - 0.5, k + 0.5]
+        double total = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            double k = (double)min + i;
+            q[i] = interval_mass((k - 0.5 - mu) / sigma, (k + 0.5 - mu) / sigma);
+            total += q[i];
+        }
+        if (total > 0) {
+            for (uint32_t i = 0; i < size; i++) {
+                q[i] *= size / total;
+            }
+            alias_pair(t, q, small, large);
+        } else {
+            alias_free(t); // The whole window is beyond the reach of double precision
+            t = NULL;
+        }
+    } else {
+        alias_free(t);
+        t = NULL;
+    }
+    free(q);
+    free(small);
+    free(large);
+    return t;
+}
+
+static int alias_matches(const alias_table_t *t, double mu, double sigma, int min, int max) {
+    return t->mu == mu && t->sigma == sigma && t->min == min && t->max == max;
+}
+
+// Drop cache slot i and free its table
+static void cache_remove(size_t i) {
+    alias_free(cache[i]);
+    cache[i] = cache[--cache_len];
+}
+
+// Make room for one more table: over ALIAS_CACHE_MAX, the least recently used
+// table nobody holds goes; if every table is held, the cache grows past it
+static int cache_reserve(void) {
+    if (cache_len >= ALIAS_CACHE_MAX) {
+        size_t lru = cache_len;
+        for (size_t i = 0; i < cache_len; i++) {
+            if (cache[i]->refs == 0 && (lru == cache_len || cache[i]->used < cache[lru]->used)) {
+                lru = i;
+            }
+        }
+        if (lru < cache_len) {
+            cache_remove(lru);
+        }
+    }
+    if (cache_len == cache_cap) {
+        size_t cap = cache_cap ? 2 * cache_cap : 16;
+        alias_table_t **grown = realloc(cache, cap * sizeof(alias_table_t *));
+        if (grown == NULL) {
+            return -1;
+        }
+        cache = grown;
+        cache_cap = cap;
+    }
+    return 0;
+}
+
+// Find or build the table for the key, and hold it
+static const alias_table_t *alias_lookup(double mu, double sigma, int min, int max) {
+    alias_table_t *found = NULL;
+    pthread_mutex_lock(&cache_lock);
+    for (size_t i = 0; i < cache_len && found == NULL; i++) {
+        if (alias_matches(cache[i], mu, sigma, min, max)) {
+            found = cache[i];
+        }
+    }
+    if (found == NULL) {
+        alias_table_t *t = alias_build(mu, sigma, min, max);
+        if (t != NULL && cache_reserve() == 0) {
+            cache[cache_len++] = t;
+            found = t;
+        } else {
+            alias_free(t);
+        }
+    }
+    if (found != NULL) {
+        found->refs++;
+        found->used = ++cache_tick;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return found;
+}
+
+const alias_table_t *alias_get(double mu, double sigma, int min, int max) {
+    if (!(sigma > 0) || min > max || (int64_t)max - min + 1 > ALIAS_MAX_SIZE) {
+        return NULL;
+    }
+    return alias_lookup(mu, sigma, min, max);
+}
+
+const alias_table_t *alias_get_normal(double mu, double sigma) {
+    double lo = floor(mu - ALIAS_NORMAL_SPAN * sigma), hi = ceil(mu + ALIAS_NORMAL_SPAN * sigma);
+    if (!(sigma > 0) || !(hi - lo + 1 <= ALIAS_MAX_SIZE) || lo < INT32_MIN || hi > INT32_MAX) {
+        return NULL;
+    }
+    return alias_lookup(mu, sigma, (int)lo, (int)hi);
+}
+
+void alias_release(const alias_table_t *t) {
+    if (t == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_lock);
+    for (size_t i = 0; i < cache_len; i++) {
+        if (cache[i] == t) {
+            // A cache grown past its cap while every table was held shrinks back
+            if (--cache[i]->refs == 0 && cache_len > ALIAS_CACHE_MAX) {
+                cache_remove(i);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void alias_fill(const alias_table_t *t, rng_engine_t *eng, int *out, size_t n) {
+    // Draw the words a block at a time so the engine loop runs without the
+    // dependent table loads in between
+    uint64_t w[ALIAS_BLOCK];
+    for (size_t done = 0; done < n; done += ALIAS_BLOCK) {
+        size_t len = n - done < ALIAS_BLOCK ? n - done : ALIAS_BLOCK;
+        engine_fill_u64(eng, w, len);
+        for (size_t i = 0; i < len; i++) {
+            unsigned __int128 p = (unsigned __int128)w[i] * t->size;
+            uint32_t col = (uint32_t)(p >> 64);
+            uint32_t k = (uint64_t)p < t->prob[col] ? col : (uint32_t)t->alias[col];
+            out[done + i] = t->min + (int)k;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * File: alias.h
+ *
+ * Purpose:
+ * Walker/Vose alias tables for the integer normals. When the support is a
+ * modest number of integers (Scenario1 spans 1..8), round(N(mu, sigma)),
+ * optionally restricted to [min, max], is a small discrete distribution.
+ * It is tabulated once from the normal CDF, after which every draw is one
+ * 64-bit word, one multiply and one table lookup: no transcendental
+ * functions and no rejection.
+ *
+ * A draw splits x * size into its high word (the column) and its low word
+ * (the coin tossed against the column's threshold), so one engine word
+ * serves both.
+ *
+ * Tables are cached by (mu, sigma, min, max) and shared between threads.
+ * Every alias_get* holds its table until the matching alias_release; the
+ * cache keeps up to ALIAS_CACHE_MAX tables, evicting the least recently
+ * used one that nobody holds, so a long-running server whose clients ask
+ * for ever new parameters does not grow without bound.
+ *
+ *****************************************************************************/
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// Largest support tabulated (12 bytes per value, so 96 KiB at most)
+#define ALIAS_MAX_SIZE 8192
+// Untruncated normals are tabulated over mu +/- ALIAS_NORMAL_SPAN sigma;
+// the mass left out is below 2e-23, far under the resolution of a draw
+#define ALIAS_NORMAL_SPAN 10
+// Tables kept once nobody holds them (at most 96 KiB each)
+#define ALIAS_CACHE_MAX 64
+
+typedef struct alias_table {
+    double mu, sigma;
+    int min, max;      // Support
+    uint32_t size;     // max - min + 1
+    uint64_t *prob;    // Keep the column when the coin is below this
+    int32_t *alias;    // Offset (from min) taken otherwise
+    uint32_t refs;     // Holders (cache bookkeeping, under the cache lock)
+    uint64_t used;     // Tick of the last lookup (likewise)
+} alias_table_t;
+
+// Table for round(N(mu, sigma)) conditioned on [min, max], held until
+// alias_release; NULL if the window is empty, wider than ALIAS_MAX_SIZE or
+// holds no mass
+const alias_table_t *alias_get(double mu, double sigma, int min, int max);
+// Table for round(N(mu, sigma)); NULL if mu +/- ALIAS_NORMAL_SPAN sigma is too wide
+const alias_table_t *alias_get_normal(double mu, double sigma);
+// Let go of a table from alias_get*; NULL is ignored
+void alias_release(const alias_table_t *t);
+// Fill out[0..n) with draws from the table
+void alias_fill(const alias_table_t *t, rng_engine_t *eng, int *out, size_t n);
+
+// One draw from the table
+static inline int alias_sample(const alias_table_t *t, rng_engine_t *eng) {
+    unsigned __int128 p = (unsigned __int128)engine_next_u64(eng) * t->size;
+    uint32_t col = (uint32_t)(p >> 64);
+    uint32_t k = (uint64_t)p < t->prob[col] ? col : (uint32_t)t->alias[col];
+    return t->min + (int)k;
+}
+
+#endif
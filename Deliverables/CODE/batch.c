@@ -0,0 +1,494 @@
+/******************************************************************************
+ * File: batch.c
+ *
+ * Purpose:
+ * Block generation and the scalar/AVX2/AVX-512 mapping kernels behind
+ * batch.h. Kernels only use exactly-rounded operations (no FMA), so the
+ * vector paths match the scalar path bit for bit.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "alias.h"
+#include "instr.h"
+#include "normal.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BATCH_HAVE_X86 1
+#endif
+
+// Random words drawn per block (16 KiB: stays in L1 while it is mapped)
+#define BATCH_BLOCK 2048
+
+typedef struct {
+    const char *name;
+    // out[i] = m + scale * u(bits[i])
+    void (*to_real)(const uint64_t *bits, double *out, size_t n, double m, double scale);
+    // out[i] = m + hi32(w[i] * range); returns how many low halves fell under t
+    // (biased draws the caller must replace)
+    size_t (*bounded32)(const uint32_t *w, int *out, size_t n, int m, uint32_t range, uint32_t t);
+    // x[i] = mu + sigma * x[i]
+    void (*affine)(double *x, size_t n, double mu, double sigma);
+    // out[i] = (int)round(mu + sigma * z[i])
+    void (*affine_round)(const double *z, int *out, size_t n, double mu, double sigma);
+} batch_kernels_t;
+
+/* ---------------------------------------------------------------- scalar */
+
+static void scalar_to_real(const uint64_t *bits, double *out, size_t n, double m, double scale) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = m + scale * engine_bits_to_double(bits[i]);
+    }
+}
+
+static size_t scalar_bounded32(const uint32_t *w, int *out, size_t n, int m, uint32_t range, uint32_t t) {
+    size_t rejected = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t p = (uint64_t)w[i] * range;
+        out[i] = (int)((uint32_t)m + (uint32_t)(p >> 32));
+        rejected += (uint32_t)p < t;
+    }
+    return rejected;
+}
+
+static void scalar_affine(double *x, size_t n, double mu, double sigma) {
+    for (size_t i = 0; i < n; i++) {
+        x[i] = mu + sigma * x[i];
+    }
+}
+
+static void scalar_affine_round(const double *z, int *out, size_t n, double mu, double sigma) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (int)round(mu + sigma * z[i]);
+    }
+}
+
+static const batch_kernels_t scalar_kernels = {
+    "scalar", scalar_to_real, scalar_bounded32, scalar_affine, scalar_affine_round};
+
+#ifdef BATCH_HAVE_X86
+/* ------------------------------------------------------------------ AVX2 */
+
+// [0, 1) doubles from the top 52 bits: (bits >> 12 | 1.0) - 1.0
+__attribute__((target("avx2"))) static inline __m256d avx2_unit(__m256i bits) {
+    const __m256i one = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    __m256i mant = _mm256_or_si256(_mm256_srli_epi64(bits, 12), one);
+    return _mm256_sub_pd(_mm256_castsi256_pd(mant), _mm256_set1_pd(1.0));
+}
+
+// round() semantics (halves away from zero): trunc, then step out if |frac| >= 0.5
+__attribute__((target("avx2"))) static inline __m256d avx2_round(__m256d x) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d t = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d frac = _mm256_andnot_pd(sign, _mm256_sub_pd(x, t));
+    __m256d step = _mm256_or_pd(_mm256_and_pd(x, sign), _mm256_set1_pd(1.0));
+    __m256d mask = _mm256_cmp_pd(frac, _mm256_set1_pd(0.5), _CMP_GE_OQ);
+    return _mm256_add_pd(t, _mm256_and_pd(mask, step));
+}
+
+__attribute__((target("avx2"))) static void avx2_to_real(const uint64_t *bits, double *out, size_t n,
+                                                         double m, double scale) {
+    const __m256d vm = _mm256_set1_pd(m), vs = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d u = avx2_unit(_mm256_loadu_si256((const __m256i *)(bits + i)));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(vm, _mm256_mul_pd(vs, u)));
+    }
+    scalar_to_real(bits + i, out + i, n - i, m, scale);
+}
+
+// 32x32->64 products of all eight lanes: even lanes directly, odd lanes shifted down
+__attribute__((target("avx2"))) static size_t avx2_bounded32(const uint32_t *w, int *out, size_t n, int m,
+                                                             uint32_t range, uint32_t t) {
+    const __m256i vr = _mm256_set1_epi64x(range);
+    const __m256i vm = _mm256_set1_epi32(m);
+    const __m256i flip = _mm256_set1_epi32((int)0x80000000u);
+    const __m256i vt = _mm256_xor_si256(_mm256_set1_epi32((int)t), flip);
+    size_t rejected = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(w + i));
+        __m256i pe = _mm256_mul_epu32(x, vr);
+        __m256i po = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), vr);
+        __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(pe, 32), po, 0xAA);
+        __m256i lo = _mm256_blend_epi32(pe, _mm256_slli_epi64(po, 32), 0xAA);
+        // Unsigned lo < t as a signed compare on sign-flipped values
+        __m256i low = _mm256_cmpgt_epi32(vt, _mm256_xor_si256(lo, flip));
+        rejected += (size_t)__builtin_popcount((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(low)));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(vm, hi));
+    }
+    return rejected + scalar_bounded32(w + i, out + i, n - i, m, range, t);
+}
+
+__attribute__((target("avx2"))) static void avx2_affine(double *x, size_t n, double mu, double sigma) {
+    const __m256d vm = _mm256_set1_pd(mu), vs = _mm256_set1_pd(sigma);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(x + i, _mm256_add_pd(vm, _mm256_mul_pd(vs, _mm256_loadu_pd(x + i))));
+    }
+    scalar_affine(x + i, n - i, mu, sigma);
+}
+
+__attribute__((target("avx2"))) static void avx2_affine_round(const double *z, int *out, size_t n, double mu,
+                                                              double sigma) {
+    const __m256d vm = _mm256_set1_pd(mu), vs = _mm256_set1_pd(sigma);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_add_pd(vm, _mm256_mul_pd(vs, _mm256_loadu_pd(z + i)));
+        _mm_storeu_si128((__m128i *)(out + i), _mm256_cvttpd_epi32(avx2_round(x)));
+    }
+    scalar_affine_round(z + i, out + i, n - i, mu, sigma);
+}
+
+static const batch_kernels_t avx2_kernels = {
+    "avx2", avx2_to_real, avx2_bounded32, avx2_affine, avx2_affine_round};
+
+/* --------------------------------------------------------------- AVX-512 */
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_unit(__m512i bits) {
+    const __m512i one = _mm512_set1_epi64(0x3FF0000000000000LL);
+    __m512i mant = _mm512_or_si512(_mm512_srli_epi64(bits, 12), one);
+    return _mm512_sub_pd(_mm512_castsi512_pd(mant), _mm512_set1_pd(1.0));
+}
+
+__attribute__((target("avx512f"))) static inline __m512d avx512_round(__m512d x) {
+    __m512d t = _mm512_roundscale_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m512d frac = _mm512_abs_pd(_mm512_sub_pd(x, t));
+    __mmask8 away = _mm512_cmp_pd_mask(frac, _mm512_set1_pd(0.5), _CMP_GE_OQ);
+    __mmask8 neg = _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ);
+    t = _mm512_mask_add_pd(t, away & ~neg, t, _mm512_set1_pd(1.0));
+    return _mm512_mask_sub_pd(t, away & neg, t, _mm512_set1_pd(1.0));
+}
+
+__attribute__((target("avx512f"))) static void avx512_to_real(const uint64_t *bits, double *out, size_t n,
+                                                              double m, double scale) {
+    const __m512d vm = _mm512_set1_pd(m), vs = _mm512_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d u = avx512_unit(_mm512_loadu_si512((const void *)(bits + i)));
+        _mm512_storeu_pd(out + i, _mm512_add_pd(vm, _mm512_mul_pd(vs, u)));
+    }
+    scalar_to_real(bits + i, out + i, n - i, m, scale);
+}
+
+__attribute__((target("avx512f"))) static size_t avx512_bounded32(const uint32_t *w, int *out, size_t n, int m,
+                                                                  uint32_t range, uint32_t t) {
+    const __m512i vr = _mm512_set1_epi64(range);
+    const __m512i vm = _mm512_set1_epi32(m);
+    const __m512i vt = _mm512_set1_epi32((int)t);
+    size_t rejected = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void *)(w + i));
+        __m512i pe = _mm512_mul_epu32(x, vr);
+        __m512i po = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), vr);
+        __m512i hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(pe, 32), po);
+        __m512i lo = _mm512_mask_blend_epi32(0xAAAA, pe, _mm512_slli_epi64(po, 32));
+        rejected += (size_t)__builtin_popcount(_mm512_cmplt_epu32_mask(lo, vt));
+        _mm512_storeu_si512((void *)(out + i), _mm512_add_epi32(vm, hi));
+    }
+    return rejected + scalar_bounded32(w + i, out + i, n - i, m, range, t);
+}
+
+__attribute__((target("avx512f"))) static void avx512_affine(double *x, size_t n, double mu, double sigma) {
+    const __m512d vm = _mm512_set1_pd(mu), vs = _mm512_set1_pd(sigma);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(x + i, _mm512_add_pd(vm, _mm512_mul_pd(vs, _mm512_loadu_pd(x + i))));
+    }
+    scalar_affine(x + i, n - i, mu, sigma);
+}
+
+__attribute__((target("avx512f"))) static void avx512_affine_round(const double *z, int *out, size_t n,
+                                                                   double mu, double sigma) {
+    const __m512d vm = _mm512_set1_pd(mu), vs = _mm512_set1_pd(sigma);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_add_pd(vm, _mm512_mul_pd(vs, _mm512_loadu_pd(z + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm512_cvttpd_epi32(avx512_round(x)));
+    }
+    scalar_affine_round(z + i, out + i, n - i, mu, sigma);
+}
+
+static const batch_kernels_t avx512_kernels = {
+    "avx512", avx512_to_real, avx512_bounded32, avx512_affine, avx512_affine_round};
+#endif
+
+/* -------------------------------------------------------------- dispatch */
+
+static const batch_kernels_t *kernels = &scalar_kernels;
+
+// Pick the widest kernel set the CPU supports (or the one forced by RNG_BATCH_ISA)
+__attribute__((constructor)) static void batch_select_kernels(void) {
+#ifdef BATCH_HAVE_X86
+    const char *force = getenv("RNG_BATCH_ISA");
+    __builtin_cpu_init();
+    if (force != NULL) {
+        if (strcmp(force, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+            kernels = &avx512_kernels;
+        } else if (strcmp(force, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+            kernels = &avx2_kernels;
+        }
+        return;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels = &avx512_kernels;
+    } else if (__builtin_cpu_supports("avx2")) {
+        kernels = &avx2_kernels;
+    }
+#endif
+}
+
+const char *batch_isa_name(void) {
+    return kernels->name;
+}
+
+/* ------------------------------------------------- per-engine sample loops */
+
+// Loops that draw one word per sample, written once and instantiated per
+// engine with its draw (NEXT) inlined, so the engine kind is resolved once
+// per block instead of once per word
+#define BATCH_ENGINE_LOOPS(E, NEXT)                                          \
+    static void ziggurat_fill_##E(rng_engine_t *eng, double *z, size_t n) { \
+        for (size_t i = 0; i < n; i++) {                                     \
+            z[i] = normal_ziggurat_bits(eng, NEXT(eng));                     \
+        }                                                                    \
+    }
+
+BATCH_ENGINE_LOOPS(xoshiro, engine_next_xoshiro)
+BATCH_ENGINE_LOOPS(philox, engine_next_philox)
+
+// z[0..n) = standard normals by the engine's method
+static void normal_fill(rng_engine_t *eng, double *z, size_t n) {
+    if (eng->normal_method == NORMAL_BOX_MULLER) {
+        for (size_t i = 0; i < n; i++) {
+            z[i] = normal_box_muller(eng);
+        }
+    } else if (eng->kind == ENGINE_XOSHIRO256PP) {
+        ziggurat_fill_xoshiro(eng, z, n);
+    } else {
+        ziggurat_fill_philox(eng, z, n);
+    }
+}
+
+/* ------------------------------------------------------------ batch API */
+
+// out[i] = m + scale * u: the constants come precomputed from the caller
+static void uniform_real_fill(rng_engine_t *eng, double *out, size_t n, double m, double scale) {
+    uint64_t bits[BATCH_BLOCK];
+    for (size_t done = 0; done < n; done += BATCH_BLOCK) {
+        size_t len = n - done < BATCH_BLOCK ? n - done : BATCH_BLOCK;
+        engine_fill_u64(eng, bits, len);
+        kernels->to_real(bits, out + done, len, m, scale);
+    }
+}
+
+void batch_uniform_real(rng_engine_t *eng, double *out, size_t n, double m, double M) {
+    uniform_real_fill(eng, out, n, m, M - m);
+}
+
+// out[i] = uniform draw in [0, range) by Lemire's multiply-shift. The words are
+// drawn as one block first; the rejection threshold is computed once per call,
+// and the rare biased word is replaced by a fresh draw taken after the block.
+// There is no vector 64x64->128 multiply, so the mapping is one scalar mul per sample.
+static void bounded_fill(rng_engine_t *eng, uint64_t *out, size_t n, uint64_t range) {
+    engine_fill_u64(eng, out, n);
+    if (range == 0) {
+        return;
+    }
+    uint64_t t = engine_bounded_threshold(range);
+    INSTR_LOCAL(rejected);
+    for (size_t i = 0; i < n; i++) {
+        unsigned __int128 p = (unsigned __int128)out[i] * range;
+        while ((uint64_t)p < t) {
+            INSTR_INC(rejected);
+            p = (unsigned __int128)engine_next_u64(eng) * range;
+        }
+        out[i] = (uint64_t)(p >> 64);
+    }
+    INSTR_ADD(INSTR_BOUNDED_DRAWS, n + rejected);
+    INSTR_ADD(INSTR_BOUNDED_REJECTED, rejected);
+}
+
+// out[i] = lo + uniform draw in [0, range), range 0 meaning all 2^32 values;
+// t is the rejection threshold of range
+static void uniform_int_fill(rng_engine_t *eng, int *out, size_t n, int lo, uint32_t range, uint32_t t) {
+    uint64_t bits[BATCH_BLOCK];
+    if (range == 0) {
+        // Full 32-bit range: every word half is already uniform
+        for (size_t done = 0; done < n; done += 2 * BATCH_BLOCK) {
+            size_t len = n - done < 2 * BATCH_BLOCK ? n - done : 2 * BATCH_BLOCK;
+            engine_fill_u64(eng, bits, (len + 1) / 2);
+            memcpy(out + done, bits, len * sizeof(int));
+        }
+        return;
+    }
+    // Ranges up to 2^32 - 1 use the 32-bit multiply-shift: two samples per word
+    for (size_t done = 0; done < n; done += 2 * BATCH_BLOCK) {
+        size_t len = n - done < 2 * BATCH_BLOCK ? n - done : 2 * BATCH_BLOCK;
+        const uint32_t *w = (const uint32_t *)bits;
+        engine_fill_u64(eng, bits, (len + 1) / 2);
+        INSTR_ADD(INSTR_BOUNDED_DRAWS, len);
+        if (kernels->bounded32(w, out + done, len, lo, range, t) == 0) {
+            continue;
+        }
+        // Replace the biased draws in index order with fresh ones (same on every ISA)
+        INSTR_LOCAL(rejected);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t p = (uint64_t)w[i] * range;
+            while ((uint32_t)p < t) {
+                INSTR_INC(rejected);
+                p = (uint64_t)(uint32_t)engine_next_u64(eng) * range;
+            }
+            out[done + i] = (int)((uint32_t)lo + (uint32_t)(p >> 32));
+        }
+        // Every rejection was answered by one more draw
+        INSTR_ADD(INSTR_BOUNDED_DRAWS, rejected);
+        INSTR_ADD(INSTR_BOUNDED_REJECTED, rejected);
+    }
+}
+
+// Range of the integers [m, M], m <= M, for uniform_int_fill (0 for all 2^32 values)
+static uint32_t int_range(int m, int M) {
+    uint64_t range64 = (uint64_t)((int64_t)M - m + 1);
+    return range64 > UINT32_MAX ? 0 : (uint32_t)range64;
+}
+
+int batch_uniform_int(rng_engine_t *eng, int *out, size_t n, int m, int M) {
+    if (m > M) {
+        return -1; // Would wrap to range 0, the full 2^32 values
+    }
+    uint32_t range = int_range(m, M);
+    uniform_int_fill(eng, out, n, m, range, range != 0 ? (uint32_t)(0 - range) % range : 0);
+    return 0;
+}
+
+int batch_uniform_int64(rng_engine_t *eng, int64_t *out, size_t n, int64_t m, int64_t M) {
+    if (m > M) {
+        return -1;
+    }
+    uint64_t range = (uint64_t)M - (uint64_t)m + 1; // 0 for the full 64-bit range
+    bounded_fill(eng, (uint64_t *)out, n, range);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (int64_t)((uint64_t)m + (uint64_t)out[i]);
+    }
+    return 0;
+}
+
+void batch_normal(rng_engine_t *eng, double *out, size_t n, double mu, double sigma) {
+    normal_fill(eng, out, n);
+    kernels->affine(out, n, mu, sigma);
+}
+
+// round(N(mu, sigma)) from table when there is one, else from normals
+static void normal_int_fill(rng_engine_t *eng, int *out, size_t n, double mu, double sigma,
+                            const alias_table_t *table) {
+    if (table != NULL) {
+        alias_fill(table, eng, out, n);
+        return;
+    }
+    double z[BATCH_BLOCK];
+    for (size_t done = 0; done < n; done += BATCH_BLOCK) {
+        size_t len = n - done < BATCH_BLOCK ? n - done : BATCH_BLOCK;
+        normal_fill(eng, z, len);
+        kernels->affine_round(z, out + done, len, mu, sigma);
+    }
+}
+
+void batch_normal_int(rng_engine_t *eng, int *out, size_t n, double mu, double sigma) {
+    // Narrow normals come straight from their alias table
+    const alias_table_t *table = alias_get_normal(mu, sigma);
+    normal_int_fill(eng, out, n, mu, sigma, table);
+    alias_release(table);
+}
+
+void batch_truncated_real(rng_engine_t *eng, double *out, size_t n, const truncnorm_t *tn) {
+    truncnorm_fill(tn, eng, out, n);
+}
+
+void batch_truncated_int(rng_engine_t *eng, int *out, size_t n, const truncnorm_t *tn) {
+    truncnorm_fill_int(tn, eng, out, n);
+}
+
+/* ------------------------------------------------- distribution objects */
+
+int batch_dist_init(batch_dist_t *d, dist_type_t type, double m, double M, double mu, double sigma) {
+    memset(d, 0, sizeof *d);
+    d->type = type;
+    d->m = m;
+    d->scale = M - m;
+    d->mu = mu;
+    d->sigma = sigma;
+    // The integer bounds must be ordered and convert to int; the negated test also rejects NaN
+    if ((type == DIST_UNIFORM_INT || type == DIST_TRUNC_INT) && !(m >= INT32_MIN && M <= INT32_MAX && m <= M)) {
+        return -1;
+    }
+    switch (type) {
+    case DIST_UNIFORM_INT:
+        d->lo = (int)m;
+        d->range = int_range((int)m, (int)M);
+        d->threshold = d->range != 0 ? (uint32_t)(0 - d->range) % d->range : 0;
+        return 0;
+    case DIST_NORMAL_INT:
+        d->alias = alias_get_normal(mu, sigma);
+        return 0;
+    case DIST_TRUNC_REAL:
+        return truncnorm_init(&d->tn, mu, sigma, m, M);
+    case DIST_TRUNC_INT:
+        return truncnorm_init_int(&d->tn, mu, sigma, (int)m, (int)M);
+    default:
+        return 0;
+    }
+}
+
+void batch_dist_free(batch_dist_t *d) {
+    alias_release(d->alias);
+    d->alias = NULL;
+    truncnorm_free(&d->tn);
+}
+
+void batch_dist_fill_int(const batch_dist_t *d, rng_engine_t *eng, int *out, size_t n) {
+    INSTR_ADD(INSTR_SAMPLES + d->type, n);
+    switch (d->type) {
+    case DIST_UNIFORM_INT:
+        uniform_int_fill(eng, out, n, d->lo, d->range, d->threshold);
+        break;
+    case DIST_NORMAL_INT:
+        normal_int_fill(eng, out, n, d->mu, d->sigma, d->alias);
+        break;
+    default:
+        truncnorm_fill_int(&d->tn, eng, out, n);
+        break;
+    }
+}
+
+void batch_dist_fill(const batch_dist_t *d, rng_engine_t *eng, double *out, size_t n) {
+    if (!dist_is_integer(d->type)) {
+        INSTR_ADD(INSTR_SAMPLES + d->type, n); // Integer types count in batch_dist_fill_int
+    }
+    switch (d->type) {
+    case DIST_UNIFORM_REAL:
+        uniform_real_fill(eng, out, n, d->m, d->scale);
+        return;
+    case DIST_NORMAL_REAL:
+        batch_normal(eng, out, n, d->mu, d->sigma);
+        return;
+    case DIST_TRUNC_REAL:
+        truncnorm_fill(&d->tn, eng, out, n);
+        return;
+    default:
+        break;
+    }
+    // Integer types: whole blocks of the integer kernels, widened
+    int ivals[2 * BATCH_BLOCK];
+    for (size_t done = 0; done < n; done += 2 * BATCH_BLOCK) {
+        size_t len = n - done < 2 * BATCH_BLOCK ? n - done : 2 * BATCH_BLOCK;
+        batch_dist_fill_int(d, eng, ivals, len);
+        for (size_t i = 0; i < len; i++) {
+            out[done + i] = ivals[i];
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * File: batch.h
+ *
+ * Purpose:
+ * Batch API that fills a caller-provided array with N samples of one
+ * distribution. Random words are drawn in blocks and then mapped to the
+ * target distribution by vector kernels (AVX-512, AVX2 or scalar), picked
+ * once at startup from the CPU features. Every kernel produces bit-identical
+ * output, so results do not depend on the machine a run happens on.
+ *
+ * The word and per-sample loops are instantiated once per engine (macro
+ * templates in batch.c and truncnorm.c), so the engine kind, normal method
+ * and truncation strategy are branched on once per block, not per sample.
+ * batch_dist_t goes one step further for a fixed distribution: its
+ * constants are computed once and filling needs no per-call setup.
+ *
+ * Set RNG_BATCH_ISA=scalar|avx2|avx512 in the environment to force a kernel.
+ *
+ *****************************************************************************/
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dist.h"
+#include "engine.h"
+#include "truncnorm.h"
+
+// Fill out[0..n) with reals uniformly distributed in [m, M)
+void batch_uniform_real(rng_engine_t *eng, double *out, size_t n, double m, double M);
+// Fill out[0..n) with integers uniformly distributed in [m, M]: exactly uniform
+// (Lemire's multiply-shift with rejection), two samples per 64-bit engine word;
+// -1 (and nothing drawn) if m > M
+int batch_uniform_int(rng_engine_t *eng, int *out, size_t n, int m, int M);
+// Same for 64-bit integers, for ranges wider than int
+int batch_uniform_int64(rng_engine_t *eng, int64_t *out, size_t n, int64_t m, int64_t M);
+// Fill out[0..n) with N(mu, sigma) reals
+void batch_normal(rng_engine_t *eng, double *out, size_t n, double mu, double sigma);
+// Fill out[0..n) with round(N(mu, sigma)), from an alias table when it is narrow
+void batch_normal_int(rng_engine_t *eng, int *out, size_t n, double mu, double sigma);
+// Fill out[0..n) from a truncated normal set up with truncnorm_init
+void batch_truncated_real(rng_engine_t *eng, double *out, size_t n, const truncnorm_t *tn);
+// Fill out[0..n) from a truncated normal set up with truncnorm_init_int
+void batch_truncated_int(rng_engine_t *eng, int *out, size_t n, const truncnorm_t *tn);
+// Name of the kernel set in use ("avx512", "avx2" or "scalar")
+const char *batch_isa_name(void);
+
+// One distribution with everything its sampling loop needs worked out once:
+// the uniform offset and scale, the integer range and its rejection
+// threshold, the alias table of a narrow normal and the truncation strategy.
+// Filling from it gives exactly the samples of the matching batch_* call.
+typedef struct {
+    dist_type_t type;
+    double m, scale;            // Uniform real: m + scale * u
+    int lo;                     // Uniform integer: lo + a draw in [0, range) ...
+    uint32_t range, threshold;  // ... (range 0: all 2^32 values) and 2^32 mod range
+    double mu, sigma;
+    const struct alias_table *alias; // Integer normal narrow enough to tabulate, else NULL
+    truncnorm_t tn;             // Truncated types
+} batch_dist_t;
+
+// Set up d for a type and its parameters (as in gen_file_t); -1 if a truncation
+// window is empty or an integer type's m, M are not ordered finite int32 values
+int batch_dist_init(batch_dist_t *d, dist_type_t type, double m, double M, double mu, double sigma);
+// Release the alias table d holds; d may come from a failed batch_dist_init
+void batch_dist_free(batch_dist_t *d);
+// Fill out[0..n) with samples of d (integer types are widened to double)
+void batch_dist_fill(const batch_dist_t *d, rng_engine_t *eng, double *out, size_t n);
+// Fill out[0..n) with samples of d, which must be an integer type
+void batch_dist_fill_int(const batch_dist_t *d, rng_engine_t *eng, int *out, size_t n);
+
+#endif
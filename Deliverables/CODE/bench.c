@@ -0,0 +1,302 @@
+/******************************************************************************
+ * File: bench.c
+ *
+ * Purpose:
+ * Throughput benchmark for the generators, so that performance can be
+ * tracked from one release to the next. It measures:
+ * 1. Samples per second of every distribution through the batch API
+ *    (uniform real/int, normal real/int, truncated normal real/int).
+ * 2. Bytes per second of formatted text through the writer (the "%.6f"
+ *    lines of the DATA files and the "%.5f" columns of output.txt).
+ * 3. Samples per second of histogram binning at the Scenario1/2/3 sizes.
+ *
+ * Every measurement is repeated and the fastest run is reported. Output is
+ * CSV (one row per measurement) or JSON, ready to be diffed or plotted.
+ *
+ * Usage:
+ * - Compile: make bench
+ * - Execute: ./bench [-f csv|json] [-N samples] [-r repeats] [-s seed]
+ *            [-e xoshiro|philox] [-n ziggurat|boxmuller] [-j threads]
+ *
+ *****************************************************************************/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "dist.h"
+#include "engine.h"
+#include "genpool.h"
+#include "hist.h"
+#include "normal.h"
+#include "truncnorm.h"
+#include "writer.h"
+
+// Samples per batch call, as in the generators
+#define BENCH_BLOCK 4096
+// Each histogram measurement bins at least this many samples in total
+#define BENCH_HIST_MIN 20000000
+
+typedef struct {
+    const char *group; // "distribution", "writer" or "histogram"
+    char name[64];
+    long long n;       // Items per run
+    double seconds;    // Fastest run
+    double rate;       // Items (or bytes) per second
+    const char *unit;
+} bench_result_t;
+
+static bench_result_t results[32];
+static int nresults;
+
+// Scenario parameters as in rns.c: mu, sigma, m, M, N
+static const double scenarios[3][5] = {
+    {5, 1, 1, 8, 20},
+    {1024, 256, 1, 2000, 200000},
+    {4096, 1.3 * 1024, 1, 8100, 2000000}};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void record(const char *group, const char *name, long long n, double seconds, double amount,
+                   const char *unit) {
+    bench_result_t *r = &results[nresults++];
+    r->group = group;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->n = n;
+    r->seconds = seconds;
+    r->rate = seconds > 0 ? amount / seconds : 0;
+    r->unit = unit;
+}
+
+// Generate n samples of one distribution in blocks; returns the elapsed time
+static double run_distribution(rng_engine_t *eng, dist_type_t type, long long n, const truncnorm_t *tn_real,
+                               const truncnorm_t *tn_int) {
+    static double dvals[BENCH_BLOCK];
+    static int ivals[BENCH_BLOCK];
+    const double *sc = scenarios[2];
+    double start = now();
+    for (long long done = 0; done < n; done += BENCH_BLOCK) {
+        size_t len = n - done < BENCH_BLOCK ? (size_t)(n - done) : BENCH_BLOCK;
+        switch (type) {
+        case DIST_UNIFORM_INT:
+            batch_uniform_int(eng, ivals, len, (int)sc[2], (int)sc[3]);
+            break;
+        case DIST_UNIFORM_REAL:
+            batch_uniform_real(eng, dvals, len, sc[2], sc[3]);
+            break;
+        case DIST_NORMAL_REAL:
+            batch_normal(eng, dvals, len, sc[0], sc[1]);
+            break;
+        case DIST_NORMAL_INT:
+            batch_normal_int(eng, ivals, len, sc[0], sc[1]);
+            break;
+        case DIST_TRUNC_REAL:
+            batch_truncated_real(eng, dvals, len, tn_real);
+            break;
+        case DIST_TRUNC_INT:
+            batch_truncated_int(eng, ivals, len, tn_int);
+            break;
+        }
+    }
+    return now() - start;
+}
+
+static void bench_distributions(rng_engine_t *eng, long long n, int repeats) {
+    truncnorm_t tn_real, tn_int;
+    const double *sc = scenarios[2];
+    truncnorm_init(&tn_real, sc[0], sc[1], sc[2], sc[3]);
+    truncnorm_init_int(&tn_int, sc[0], sc[1], (int)sc[2], (int)sc[3]);
+    for (int type = 1; type <= DIST_COUNT; type++) {
+        double best = 0;
+        for (int r = 0; r < repeats; r++) {
+            double t = run_distribution(eng, (dist_type_t)type, n, &tn_real, &tn_int);
+            best = r == 0 || t < best ? t : best;
+        }
+        record("distribution", dist_file_name(type), n, best, (double)n, "samples/s");
+    }
+    truncnorm_free(&tn_int);
+}
+
+// Format n values through a writer into /dev/null; returns bytes per run via *bytes
+static double run_writer(const double *vals, long long n, int columns, size_t *bytes) {
+    text_writer_t w;
+    int fd = open("/dev/null", O_WRONLY);
+    size_t total = 0;
+    writer_attach(&w, fd);
+    double start = now();
+    for (long long i = 0; i < n; i++) {
+        size_t before = w.len;
+        if (columns) {
+            // One output.txt style column: "%.5f\t"
+            writer_put_fixed(&w, vals[i], 5);
+            writer_put_char(&w, '\t');
+        } else {
+            // One DATA file line: "%.6f\n"
+            writer_put_fixed(&w, vals[i], 6);
+            writer_put_char(&w, '\n');
+        }
+        // A flush inside the call empties the buffer, so count from the new length
+        total += w.len > before ? w.len - before : w.len;
+    }
+    writer_flush(&w);
+    double t = now() - start;
+    writer_close(&w);
+    close(fd);
+    *bytes = total;
+    return t;
+}
+
+static void bench_writers(rng_engine_t *eng, long long n, int repeats) {
+    double *vals = malloc((size_t)n * sizeof(double));
+    if (vals == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    batch_normal(eng, vals, (size_t)n, scenarios[2][0], scenarios[2][1]);
+    const char *names[2] = {"data_line_6dp", "output_column_5dp"};
+    for (int columns = 0; columns < 2; columns++) {
+        double best = 0;
+        size_t bytes = 0;
+        for (int r = 0; r < repeats; r++) {
+            double t = run_writer(vals, n, columns, &bytes);
+            best = r == 0 || t < best ? t : best;
+        }
+        record("writer", names[columns], n, best, (double)bytes, "bytes/s");
+    }
+    free(vals);
+}
+
+static void bench_histograms(rng_engine_t *eng, int repeats, int threads) {
+    for (int s = 0; s < 3; s++) {
+        const double *sc = scenarios[s];
+        long long n = (long long)sc[4];
+        double *vals = malloc((size_t)n * sizeof(double));
+        if (vals == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        batch_normal(eng, vals, (size_t)n, sc[0], sc[1]);
+
+        // Small inputs are binned many times over so the timer has something to measure
+        long long rounds = BENCH_HIST_MIN / n > 0 ? BENCH_HIST_MIN / n : 1;
+        double best = 0;
+        for (int r = 0; r < repeats; r++) {
+            hist_t h;
+            hist_init(&h, 50, sc[0] - 4 * sc[1], sc[0] + 4 * sc[1], HIST_CLAMP);
+            double start = now();
+            for (long long k = 0; k < rounds; k++) {
+                hist_add_parallel(&h, vals, DS_FLOAT64, (uint64_t)n, threads);
+            }
+            double t = now() - start;
+            hist_free(&h);
+            best = r == 0 || t < best ? t : best;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "scenario%d", s + 1);
+        record("histogram", name, n, best / (double)rounds, (double)n, "samples/s");
+        free(vals);
+    }
+}
+
+static void print_csv(const rng_engine_t *eng, int threads) {
+    printf("group,name,n,seconds,rate,unit,engine,normal,isa,threads\n");
+    for (int i = 0; i < nresults; i++) {
+        const bench_result_t *r = &results[i];
+        printf("%s,%s,%lld,%.9f,%.0f,%s,%s,%s,%s,%d\n", r->group, r->name, r->n, r->seconds, r->rate, r->unit,
+               engine_kind_name(eng->kind), normal_method_name(eng->normal_method), batch_isa_name(), threads);
+    }
+}
+
+static void print_json(const rng_engine_t *eng, int threads) {
+    printf("{\n  \"engine\": \"%s\",\n  \"normal\": \"%s\",\n  \"isa\": \"%s\",\n  \"threads\": %d,\n",
+           engine_kind_name(eng->kind), normal_method_name(eng->normal_method), batch_isa_name(), threads);
+    printf("  \"results\": [\n");
+    for (int i = 0; i < nresults; i++) {
+        const bench_result_t *r = &results[i];
+        printf("    {\"group\": \"%s\", \"name\": \"%s\", \"n\": %lld, \"seconds\": %.9f, \"rate\": %.0f, "
+               "\"unit\": \"%s\"}%s\n",
+               r->group, r->name, r->n, r->seconds, r->rate, r->unit, i + 1 < nresults ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t seed = 1;
+    engine_kind_t kind = ENGINE_XOSHIRO256PP;
+    normal_method_t method = NORMAL_ZIGGURAT;
+    long long n = 1 << 24;
+    int repeats = 3;
+    int threads = genpool_default_threads();
+    int json = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:N:r:s:e:n:j:")) != -1) {
+        switch (opt) {
+        case 'f':
+            if (strcmp(optarg, "csv") != 0 && strcmp(optarg, "json") != 0) {
+                fprintf(stderr, "Unknown format '%s' (use csv or json)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            json = strcmp(optarg, "json") == 0;
+            break;
+        case 'N':
+            n = atoll(optarg);
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            if (engine_kind_from_name(optarg) < 0) {
+                fprintf(stderr, "Unknown engine '%s' (use xoshiro or philox)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            kind = (engine_kind_t)engine_kind_from_name(optarg);
+            break;
+        case 'n':
+            if (normal_method_from_name(optarg) < 0) {
+                fprintf(stderr, "Unknown normal method '%s' (use ziggurat or boxmuller)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            method = (normal_method_t)normal_method_from_name(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-f csv|json] [-N samples] [-r repeats] [-s seed] [-e xoshiro|philox] "
+                    "[-n ziggurat|boxmuller] [-j threads]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (n < 1 || repeats < 1) {
+        fprintf(stderr, "-N and -r must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    rng_engine_t eng;
+    engine_init(&eng, kind, seed);
+    eng.normal_method = method;
+
+    bench_distributions(&eng, n, repeats);
+    bench_writers(&eng, n, repeats);
+    bench_histograms(&eng, repeats, threads);
+
+    if (json) {
+        print_json(&eng, threads);
+    } else {
+        print_csv(&eng, threads);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+/******************************************************************************
+ * File: check_format.c
+ *
+ * Purpose:
+ * Checks the hand-written number conversions against the C library they
+ * replace, since a silent difference there would change the DATA files or
+ * the numbers read back from them:
+ * 1. fmt_fixed (writer.h) against snprintf("%.*f") for every precision it
+ *    takes: random values of every magnitude, values next to a rounding tie,
+ *    -0, values that round to -0, subnormals, huge values, inf and nan.
+ * 2. textread_number (textread.h) against strtod: the value (bit for bit)
+ *    and the bytes consumed, for "%.6f" lines, more than 19 significant
+ *    digits, more than 22 decimals, exponents, signs, blanks, inf/nan, hex
+ *    and text that is not a number at all.
+ *
+ * Prints one line per check and the first mismatches, and exits non-zero if
+ * there is any.
+ *
+ * Usage:
+ * - Compile: make check_format
+ * - Execute: make check, or ./check_format [-n values] [-s seed]
+ *
+ *****************************************************************************/
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "textread.h"
+#include "writer.h"
+
+// Precisions fmt_fixed takes
+#define CHECK_MAX_PREC 9
+// Mismatches printed per check
+#define CHECK_SHOW 5
+
+static long long checked, failed;
+
+static double bits_double(uint64_t u) {
+    double x;
+    memcpy(&x, &u, sizeof x);
+    return x;
+}
+
+static int same_double(double a, double b) {
+    return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof a) == 0;
+}
+
+// A random double of magnitude 10^-12 .. 10^18 and either sign
+static double random_magnitude(rng_engine_t *eng) {
+    double e = -12 + 30 * ((double)(engine_next_u64(eng) >> 11) * 0x1p-53);
+    double x = pow(10, e);
+    return engine_next_u64(eng) & 1 ? -x : x;
+}
+
+static void check_fixed(double x, int prec) {
+    char want[FMT_MAX + 1], got[FMT_MAX + 1];
+    int n = snprintf(want, sizeof want, "%.*f", prec, x);
+    size_t len = fmt_fixed(got, x, prec);
+    checked++;
+    if ((size_t)n != len || memcmp(want, got, len) != 0) {
+        if (failed++ < CHECK_SHOW) {
+            printf("  fmt_fixed(%a, %d): \"%.*s\", printf: \"%s\"\n", x, prec, (int)len, got, want);
+        }
+    }
+}
+
+static void check_fmt_fixed(rng_engine_t *eng, long long n) {
+    static const double specials[] = {0.0, -0.0, 0.5, -0.5, 1.5, 2.5, 1e-7, -1e-7, 4e-7, -4e-7,
+                                      DBL_MIN, -DBL_MIN, 4.9e-324, -4.9e-324, DBL_MAX, -DBL_MAX,
+                                      1e15, 1e15 - 1, 999999999.9999995, 0.1, 0.7, 1e50, 1e300};
+    long long before = failed;
+    checked = 0;
+    for (int prec = 0; prec <= CHECK_MAX_PREC; prec++) {
+        for (size_t i = 0; i < sizeof specials / sizeof specials[0]; i++) {
+            check_fixed(specials[i], prec);
+        }
+        check_fixed(INFINITY, prec);
+        check_fixed(-INFINITY, prec);
+        check_fixed(NAN, prec);
+        check_fixed(-NAN, prec);
+        double scale = pow(10, prec);
+        for (long long i = 0; i < n; i++) {
+            // Any bit pattern, then the magnitudes the data files hold
+            check_fixed(bits_double(engine_next_u64(eng)), prec);
+            check_fixed(random_magnitude(eng), prec);
+            // A tie k + 0.5 at this precision and its neighbours
+            int bits = 1 + (int)(engine_next_u64(eng) % 40);
+            double k = (double)(engine_next_u64(eng) >> (64 - bits));
+            double tie = (k + 0.5) / scale;
+            check_fixed(tie, prec);
+            check_fixed(nextafter(tie, 0), prec);
+            check_fixed(nextafter(tie, INFINITY), prec);
+            check_fixed(-tie, prec);
+        }
+    }
+    printf("fmt_fixed: %lld values, %lld mismatches\n", checked, failed - before);
+}
+
+static void check_number(const char *s) {
+    const char *end = s + strlen(s);
+    double got = 0, want;
+    char *stop;
+    want = strtod(s, &stop);
+    const char *q = textread_number(s, end, &got);
+    long long want_len = stop == s ? -1 : (long long)(stop - s);
+    long long got_len = q == NULL ? -1 : (long long)(q - s);
+    checked++;
+    if (want_len != got_len || (want_len >= 0 && !same_double(want, got))) {
+        if (failed++ < CHECK_SHOW) {
+            printf("  textread_number(\"%s\"): %a after %lld bytes, strtod: %a after %lld\n", s, got, got_len, want,
+                   want_len);
+        }
+    }
+}
+
+static void check_textread_number(rng_engine_t *eng, long long n) {
+    static const char *specials[] = {
+        "0", "-0", "+0", "-0.000000", "0.000000", "1", "-1", "+3.25", ".5", "-.5", "5.", ".", "-", "+", "",
+        "  12.5", "\t-7.000001", "   ", "abc", "12abc", "1.5e", "1.5e+", "1e5", "1E-3", "-2.5e-310", "1e308",
+        "1e309", "-1e400", "4.9e-324", "2.4703282292062327e-324", "inf", "-inf", "INF", "infinity", "nan",
+        "-nan", "NaN(123)", "0x1.8p3", "-0X10", "9007199254740992", "9007199254740993", "18446744073709551615",
+        "18446744073709551616", "12345678901234567890123", "0.1234567890123456789012",
+        "0.12345678901234567890123", "0.00000000000000000000001", "0.000000000000000000000001",
+        "1.7976931348623157e308", "0000000000000000000000001.5", "1.0000000000000000000000000000001",
+        "123456.7890123456789", "-999999999.9999995", "1e-5\n", "3.5 4.5"};
+    long long before = failed;
+    checked = 0;
+    for (size_t i = 0; i < sizeof specials / sizeof specials[0]; i++) {
+        check_number(specials[i]);
+    }
+    char s[512];
+    for (long long i = 0; i < n; i++) {
+        double x = random_magnitude(eng);
+        double any = bits_double(engine_next_u64(eng));
+        // Lines as the generators write them
+        snprintf(s, sizeof s, "%.6f", x);
+        check_number(s);
+        snprintf(s, sizeof s, "%.5f", x);
+        check_number(s);
+        // 17 significant digits, more than 22 decimals, exponents
+        snprintf(s, sizeof s, "%.17g", x);
+        check_number(s);
+        snprintf(s, sizeof s, "%.25f", x / 1e6);
+        check_number(s);
+        snprintf(s, sizeof s, "%.20e", any);
+        check_number(s);
+        snprintf(s, sizeof s, "%.17g", any);
+        check_number(s);
+        // 1 to 30 random digits, a point somewhere among them, maybe a sign
+        int digits = 1 + (int)(engine_next_u64(eng) % 30);
+        int point = (int)(engine_next_u64(eng) % (uint64_t)(digits + 1));
+        size_t len = 0;
+        uint64_t r = engine_next_u64(eng);
+        if (r & 1) {
+            s[len++] = r & 2 ? '-' : '+';
+        }
+        for (int d = 0; d < digits; d++) {
+            if (d == point && (r & 4)) {
+                s[len++] = '.';
+            }
+            s[len++] = (char)('0' + engine_next_u64(eng) % 10);
+        }
+        s[len] = '\0';
+        check_number(s);
+    }
+    printf("textread_number: %lld strings, %lld mismatches\n", checked, failed - before);
+}
+
+int main(int argc, char *argv[]) {
+    long long n = 200000;
+    uint64_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            n = atoll(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n values] [-s seed]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (n < 0) {
+        fprintf(stderr, "-n must not be negative\n");
+        return EXIT_FAILURE;
+    }
+
+    rng_engine_t eng;
+    engine_init(&eng, ENGINE_XOSHIRO256PP, seed);
+    check_fmt_fixed(&eng, n);
+    check_textread_number(&eng, n);
+    if (failed != 0) {
+        printf("FAILED: %lld mismatches\n", failed);
+        return EXIT_FAILURE;
+    }
+    printf("OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * File: dataset.c
+ *
+ * Purpose:
+ * Header helpers, writer and zero-copy mmap reader for the .bin format
+ * described in dataset.h.
+ *
+ *****************************************************************************/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "writer.h"
+
+_Static_assert(sizeof(dataset_header_t) == DATASET_HEADER_SIZE, "dataset header must stay 128 bytes");
+
+void dataset_header_init(dataset_header_t *hdr, ds_elem_t elem_type, uint64_t count) {
+    memset(hdr, 0, sizeof *hdr);
+    memcpy(hdr->magic, DATASET_MAGIC, sizeof DATASET_MAGIC);
+    hdr->version = DATASET_VERSION;
+    hdr->endian_tag = DATASET_ENDIAN_TAG;
+    hdr->header_size = DATASET_HEADER_SIZE;
+    hdr->elem_type = elem_type;
+    hdr->count = count;
+}
+
+size_t dataset_elem_size(uint32_t elem_type) {
+    return elem_type == DS_INT32 ? sizeof(int32_t) : elem_type == DS_FLOAT64 ? sizeof(double) : 0;
+}
+
+int dataset_map(const char *path, dataset_t *ds) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    memset(ds, 0, sizeof *ds);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < DATASET_HEADER_SIZE) {
+        fprintf(stderr, "%s: not a dataset file\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping stays valid after close
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    const dataset_header_t *hdr = map;
+    size_t esize = dataset_elem_size(hdr->elem_type);
+    if (memcmp(hdr->magic, DATASET_MAGIC, sizeof DATASET_MAGIC) != 0 || hdr->endian_tag != DATASET_ENDIAN_TAG ||
+        hdr->version != DATASET_VERSION || esize == 0 || hdr->header_size < DATASET_HEADER_SIZE ||
+        hdr->header_size > (uint64_t)st.st_size || hdr->header_size % esize != 0 ||
+        hdr->count > ((size_t)st.st_size - hdr->header_size) / esize) {
+        fprintf(stderr, "%s: bad or truncated dataset header\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    ds->hdr = hdr;
+    ds->data = (const char *)map + hdr->header_size;
+    ds->count = hdr->count;
+    ds->map = map;
+    ds->map_size = (size_t)st.st_size;
+    return 0;
+}
+
+void dataset_unmap(dataset_t *ds) {
+    if (ds->map != NULL) {
+        munmap(ds->map, ds->map_size);
+    }
+    memset(ds, 0, sizeof *ds);
+}
+
+int dataset_create(const char *path, const dataset_header_t *hdr) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || write_all(fd, (const char *)hdr, sizeof *hdr) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int dataset_extend(const char *path, const dataset_header_t *hdr, uint64_t keep) {
+    off_t end = (off_t)(sizeof *hdr + keep * dataset_elem_size(hdr->elem_type));
+    int fd = open(path, O_WRONLY);
+    if (fd < 0 || write_all(fd, (const char *)hdr, sizeof *hdr) != 0 || ftruncate(fd, end) != 0 ||
+        lseek(fd, end, SEEK_SET) != end) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int dataset_write(const char *path, const dataset_header_t *hdr, const void *data) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    size_t bytes = (size_t)hdr->count * dataset_elem_size(hdr->elem_type);
+    int rc = write_all(fd, (const char *)hdr, sizeof *hdr) == 0 && write_all(fd, data, bytes) == 0 ? 0 : -1;
+    if (close(fd) != 0 || rc != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+long long dataset_read_text(FILE *file, double **out) {
+    size_t cap = 1 << 16, n = 0;
+    double *vals = malloc(cap * sizeof(double));
+    char line[256];
+    while (vals != NULL && fgets(line, sizeof(line), file) != NULL) {
+        char *end;
+        double v = strtod(line, &end);
+        if (end == line) {
+            continue; // Blank or non-numeric line
+        }
+        if (n == cap) {
+            cap *= 2;
+            double *grown = realloc(vals, cap * sizeof(double));
+            if (grown == NULL) {
+                free(vals);
+                vals = NULL;
+                break;
+            }
+            vals = grown;
+        }
+        vals[n++] = v;
+    }
+    if (vals == NULL) {
+        return -1;
+    }
+    *out = vals;
+    return (long long)n;
+}
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * File: dataset.h
+ *
+ * Purpose:
+ * Binary dataset format (.bin) written next to, or instead of, the DATA
+ * text files. A file is a fixed 128-byte self-describing header followed by
+ * the samples as one packed little-endian array (float64 or int32), so it
+ * can be mmap()ed and used in place without any parsing.
+ *
+ * Layout:
+ *   offset 0    dataset_header_t (header_size bytes)
+ *   offset 128  count elements of elem_type
+ *
+ *****************************************************************************/
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#define DATASET_MAGIC "RNGDSET"
+#define DATASET_VERSION 1
+#define DATASET_HEADER_SIZE 128
+#define DATASET_ENDIAN_TAG 0x01020304u
+
+typedef enum {
+    DS_FLOAT64 = 1,
+    DS_INT32 = 2
+} ds_elem_t;
+
+typedef struct {
+    char magic[8];          // "RNGDSET\0"
+    uint32_t version;       // DATASET_VERSION
+    uint32_t endian_tag;    // DATASET_ENDIAN_TAG as written by the producer
+    uint32_t header_size;   // Offset of the first element
+    uint32_t elem_type;     // ds_elem_t
+    uint32_t distribution;  // dist_type_t (dist.h), 0 if unknown
+    uint32_t engine;        // engine_kind_t
+    uint32_t normal_method; // normal_method_t
+    uint32_t stream;        // Long-jump stream of the file within its run
+    double mu, sigma, m, M;
+    uint64_t count;         // Number of elements
+    uint64_t seed;
+    uint32_t sequence;      // qmc_kind_t (qmc.h); 0 for the engine
+    uint32_t dimension;     // Coordinate of the quasi-random sequence
+    uint8_t reserved[32];
+} dataset_header_t;
+
+typedef struct {
+    const dataset_header_t *hdr;
+    const void *data;       // count elements of hdr->elem_type
+    uint64_t count;
+    void *map;
+    size_t map_size;
+} dataset_t;
+
+// Fill a header with the given metadata (magic, version, sizes set here)
+void dataset_header_init(dataset_header_t *hdr, ds_elem_t elem_type, uint64_t count);
+// Bytes per element of the given type
+size_t dataset_elem_size(uint32_t elem_type);
+// mmap a .bin file read-only and validate its header; 0 on success
+int dataset_map(const char *path, dataset_t *ds);
+// Release a mapping made by dataset_map
+void dataset_unmap(dataset_t *ds);
+// Create path and write the header; returns the fd to append elements to, or -1
+int dataset_create(const char *path, const dataset_header_t *hdr);
+// Reopen an existing path for appending: rewrite its header with hdr and cut
+// it after the first keep elements; returns the fd, or -1
+int dataset_extend(const char *path, const dataset_header_t *hdr, uint64_t keep);
+// Write a whole dataset (header + elements) to path; 0 on success
+int dataset_write(const char *path, const dataset_header_t *hdr, const void *data);
+// Read every numeric line of a text data file; returns the count (vals in *out) or -1
+long long dataset_read_text(FILE *file, double **out);
+// Element i as a double, whatever the element type
+static inline double dataset_get(const dataset_t *ds, uint64_t i) {
+    if (ds->hdr->elem_type == DS_INT32) {
+        return ((const int32_t *)ds->data)[i];
+    }
+    return ((const double *)ds->data)[i];
+}
+
+#endif
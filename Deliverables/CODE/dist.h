@@ -0,0 +1,52 @@
+/******************************************************************************
+ * File: dist.h
+ *
+ * Purpose:
+ * Distribution type codes shared by the generators, the data file writers
+ * and the binary dataset format. The codes are stored in .bin files and
+ * accepted as numbers in rns spec files, so existing codes must never change.
+ *
+ *****************************************************************************/
+#ifndef DIST_H
+#define DIST_H
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    DIST_UNIFORM_INT = 1,
+    DIST_UNIFORM_REAL = 2,
+    DIST_NORMAL_REAL = 3,
+    DIST_NORMAL_INT = 4,
+    DIST_TRUNC_REAL = 5, // Truncated to [m, M]
+    DIST_TRUNC_INT = 6   // Truncated to the integers [m, M]
+} dist_type_t;
+
+#define DIST_COUNT 6
+
+// Data file base name of each type ("uniform_integers", ...), NULL if unknown
+static inline const char *dist_file_name(int type) {
+    static const char *names[DIST_COUNT + 1] = {NULL, "uniform_integers", "uniform_real", "normal_real",
+                                                "normal_integer", "truncated_normal_real",
+                                                "truncated_normal_integer"};
+    return type >= 1 && type <= DIST_COUNT ? names[type] : NULL;
+}
+
+// Type code from its data file name or its number ("normal_real" or "3"); -1 if unknown
+static inline int dist_type_from_name(const char *name) {
+    for (int t = 1; t <= DIST_COUNT; t++) {
+        if (strcmp(name, dist_file_name(t)) == 0) {
+            return t;
+        }
+    }
+    char *end;
+    long t = strtol(name, &end, 10);
+    return *name != '\0' && *end == '\0' && t >= 1 && t <= DIST_COUNT ? (int)t : -1;
+}
+
+// Non-zero for the types whose samples are integers
+static inline int dist_is_integer(int type) {
+    return type == DIST_UNIFORM_INT || type == DIST_NORMAL_INT || type == DIST_TRUNC_INT;
+}
+
+#endif
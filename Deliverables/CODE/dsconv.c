@@ -0,0 +1,266 @@
+/******************************************************************************
+ * File: dsconv.c
+ *
+ * Purpose:
+ * Converts data files between the DATA text layout (one "%.6f" sample per
+ * line) and the binary dataset format of dataset.h, prints the header
+ * of a .bin file, and computes the moments of either kind of file. For a
+ * .bin file whose header names its distribution, stats also prints sketch
+ * quantiles and tests the samples against that distribution (gof.h); text
+ * files carry no parameters, so convert them with txt2bin -t -p first.
+ * Text files are mmap()ed and parsed in parallel (textread.h).
+ *
+ * Usage:
+ * - Compile: gcc dsconv.c dataset.c writer.c textread.c stats.c hist.c kll.c gof.c genpool.c qmc.c engine.c normal.c truncnorm.c alias.c batch.c instr.c -lm -lpthread -o dsconv
+ * - ./dsconv [-t type] [-p mu,sigma,m,M] [-s seed] txt2bin in.txt out.bin
+ *     -t: distribution type 1..6 (see dist.h); integer types are stored as int32
+ * - ./dsconv bin2txt in.bin out.txt
+ * - ./dsconv info in.bin
+ * - ./dsconv stats in.txt|in.bin
+ *
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "dist.h"
+#include "genpool.h"
+#include "gof.h"
+#include "kll.h"
+#include "qmc.h"
+#include "stats.h"
+#include "textread.h"
+#include "writer.h"
+
+static int txt_to_bin(const char *in, const char *out, int type, const double params[4], uint64_t seed) {
+    double *vals;
+    text_map_t tm;
+    if (textread_map(in, &tm) != 0) {
+        return -1;
+    }
+    long long n = textread_parse(&tm, &vals, genpool_default_threads());
+    textread_unmap(&tm);
+    if (n < 0) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    dataset_header_t hdr;
+    int is_int = dist_is_integer(type);
+    dataset_header_init(&hdr, is_int ? DS_INT32 : DS_FLOAT64, (uint64_t)n);
+    hdr.distribution = (uint32_t)type;
+    hdr.mu = params[0];
+    hdr.sigma = params[1];
+    hdr.m = params[2];
+    hdr.M = params[3];
+    hdr.seed = seed;
+
+    const void *data = vals;
+    if (is_int) {
+        // Narrow in place: int32 elements never overtake the doubles they replace
+        int32_t *ints = (int32_t *)vals;
+        for (long long i = 0; i < n; i++) {
+            ints[i] = (int32_t)vals[i];
+        }
+    }
+    int rc = dataset_write(out, &hdr, data);
+    free(vals);
+    return rc;
+}
+
+static int bin_to_txt(const char *in, const char *out) {
+    dataset_t ds;
+    text_writer_t w;
+    if (dataset_map(in, &ds) != 0) {
+        return -1;
+    }
+    if (writer_open(&w, out) != 0) {
+        perror(out);
+        dataset_unmap(&ds);
+        return -1;
+    }
+    for (uint64_t i = 0; i < ds.count; i++) {
+        writer_put_fixed(&w, dataset_get(&ds, i), 6);
+        writer_put_char(&w, '\n');
+    }
+    dataset_unmap(&ds);
+    if (writer_close(&w) != 0) {
+        perror(out);
+        return -1;
+    }
+    return 0;
+}
+
+static int print_info(const char *in) {
+    dataset_t ds;
+    if (dataset_map(in, &ds) != 0) {
+        return -1;
+    }
+    const dataset_header_t *h = ds.hdr;
+    const char *name = dist_file_name((int)h->distribution);
+    printf("File:          %s\n", in);
+    printf("Distribution:  %u (%s)\n", h->distribution, name != NULL ? name : "unknown");
+    printf("Element type:  %s\n", h->elem_type == DS_INT32 ? "int32" : "float64");
+    printf("Count:         %llu\n", (unsigned long long)h->count);
+    printf("mu, sigma:     %g, %g\n", h->mu, h->sigma);
+    printf("m, M:          %g, %g\n", h->m, h->M);
+    printf("Seed:          %llu (engine %u, normal method %u, stream %u)\n", (unsigned long long)h->seed,
+           h->engine, h->normal_method, h->stream);
+    if (h->sequence != QMC_NONE) {
+        printf("Sequence:      %s, coordinate %u\n", qmc_kind_name((qmc_kind_t)h->sequence), h->dimension);
+    }
+    dataset_unmap(&ds);
+    return 0;
+}
+
+// Sketch and goodness of fit of a .bin file against the distribution in its header
+static int print_shape(const dataset_t *ds) {
+    static const double probs[5] = {0.01, 0.25, 0.5, 0.75, 0.99};
+    const dataset_header_t *h = ds->hdr;
+    kll_t sketch;
+    gof_t gof;
+    int have_gof = h->distribution != 0 &&
+                   gof_init(&gof, (dist_type_t)h->distribution, h->m, h->M, h->mu, h->sigma, 0) == 0;
+    double *block = malloc(GEN_BLOCK * sizeof(double));
+    if (block == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        if (have_gof) {
+            gof_free(&gof);
+        }
+        return -1;
+    }
+    kll_init(&sketch, KLL_K);
+    for (uint64_t i = 0; i < ds->count; i += GEN_BLOCK) {
+        size_t n = ds->count - i < GEN_BLOCK ? (size_t)(ds->count - i) : GEN_BLOCK;
+        const double *x = (const double *)ds->data + i;
+        if (h->elem_type == DS_INT32) {
+            for (size_t j = 0; j < n; j++) {
+                block[j] = ((const int32_t *)ds->data)[i + j];
+            }
+            x = block;
+        }
+        kll_push_batch(&sketch, x, n);
+        if (have_gof) {
+            gof_push_batch(&gof, x, n);
+        }
+    }
+    free(block);
+
+    double q[5];
+    kll_quantiles(&sketch, probs, q, 5);
+    printf("P01/P25/P50:   %.5f, %.5f, %.5f\n", q[0], q[1], q[2]);
+    printf("P75/P99:       %.5f, %.5f\n", q[3], q[4]);
+    kll_free(&sketch);
+    if (have_gof) {
+        double ks_p, chi2_p;
+        int df;
+        double ks = gof_ks(&gof, &ks_p);
+        double chi2 = gof_chi2(&gof, &df, &chi2_p);
+        printf("Target:        %s\n", dist_file_name((dist_type_t)h->distribution));
+        printf("KS D, p:       %.6f, %.4f\n", ks, ks_p);
+        printf("Chi2, df, p:   %.2f, %d, %.4f\n", chi2, df, chi2_p);
+        gof_free(&gof);
+    }
+    return 0;
+}
+
+// Moments of a text or .bin data file, in one pass (plus the shape of a .bin file)
+static int print_stats(const char *in) {
+    stats_acc_t acc;
+    size_t len = strlen(in);
+    dataset_t ds;
+    int bin = len > 4 && strcmp(in + len - 4, ".bin") == 0;
+    stats_init(&acc);
+    if (bin) {
+        if (dataset_map(in, &ds) != 0) {
+            return -1;
+        }
+        if (ds.hdr->elem_type == DS_INT32) {
+            stats_push_batch_int(&acc, ds.data, (size_t)ds.count);
+        } else {
+            stats_push_batch(&acc, ds.data, (size_t)ds.count);
+        }
+    } else {
+        text_map_t tm;
+        if (textread_map(in, &tm) != 0) {
+            return -1;
+        }
+        long long n = textread_scan(&tm, genpool_default_threads(), &acc, NULL);
+        textread_unmap(&tm);
+        if (n < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return -1;
+        }
+    }
+    printf("File:          %s\n", in);
+    printf("Count:         %llu\n", (unsigned long long)acc.n);
+    printf("Mean:          %.5f\n", stats_mean(&acc));
+    printf("Stddev:        %.5f\n", stats_stddev(&acc));
+    printf("Min, Max:      %.5f, %.5f\n", acc.min, acc.max);
+    printf("Skew, Kurt:    %.5f, %.5f\n", stats_skewness(&acc), stats_kurtosis(&acc));
+    int rc = 0;
+    if (bin) {
+        rc = print_shape(&ds);
+        dataset_unmap(&ds);
+    }
+    return rc;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t type] [-p mu,sigma,m,M] [-s seed] txt2bin in.txt out.bin\n"
+            "       %s bin2txt in.bin out.txt\n"
+            "       %s info in.bin\n"
+            "       %s stats in.txt|in.bin\n",
+            prog, prog, prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    int type = DIST_UNIFORM_REAL;
+    double params[4] = {0, 0, 0, 0};
+    uint64_t seed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:s:")) != -1) {
+        switch (opt) {
+        case 't':
+            type = atoi(optarg);
+            if (dist_file_name(type) == NULL) {
+                fprintf(stderr, "Unknown distribution type %s (use 1..%d)\n", optarg, DIST_COUNT);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            if (sscanf(optarg, "%lf,%lf,%lf,%lf", &params[0], &params[1], &params[2], &params[3]) != 4) {
+                fprintf(stderr, "-p expects mu,sigma,m,M\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int rest = argc - optind;
+    char **args = argv + optind;
+    int rc;
+    if (rest == 3 && strcmp(args[0], "txt2bin") == 0) {
+        rc = txt_to_bin(args[1], args[2], type, params, seed);
+    } else if (rest == 3 && strcmp(args[0], "bin2txt") == 0) {
+        rc = bin_to_txt(args[1], args[2]);
+    } else if (rest == 2 && strcmp(args[0], "info") == 0) {
+        rc = print_info(args[1]);
+    } else if (rest == 2 && strcmp(args[0], "stats") == 0) {
+        rc = print_stats(args[1]);
+    } else {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * File: engine.c
+ *
+ * Purpose:
+ * Seeding, jump-ahead and the Philox block function for the engines declared
+ * in engine.h. The per-draw fast path lives in the header so it inlines into
+ * the generator loops.
+ *
+ *****************************************************************************/
+#include "engine.h"
+
+// xoshiro256++ jump polynomial: equivalent to 2^128 calls to next
+static const uint64_t XOSHIRO_JUMP[4] = {
+    UINT64_C(0x180ec6d33cfd0aba), UINT64_C(0xd5a61266f0c9392c),
+    UINT64_C(0xa9582618e03fc9aa), UINT64_C(0x39abdc4529b1661c)};
+
+// xoshiro256++ long-jump polynomial: equivalent to 2^192 calls to next
+static const uint64_t XOSHIRO_LONG_JUMP[4] = {
+    UINT64_C(0x76e15d3efefdcbbf), UINT64_C(0xc5004e441c522fb3),
+    UINT64_C(0x77710069854ee241), UINT64_C(0x39109bb02acbe635)};
+
+// Philox4x32 multipliers and Weyl key increments
+#define PHILOX_M0 UINT32_C(0xD2511F53)
+#define PHILOX_M1 UINT32_C(0xCD9E8D57)
+#define PHILOX_W0 UINT32_C(0x9E3779B9)
+#define PHILOX_W1 UINT32_C(0xBB67AE85)
+#define PHILOX_ROUNDS 10
+
+// SplitMix64 step, used to expand a 64-bit seed into engine state
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+void engine_init(rng_engine_t *eng, engine_kind_t kind, uint64_t seed) {
+    uint64_t sm = seed;
+    memset(eng, 0, sizeof *eng);
+    eng->kind = kind;
+    eng->seed = seed;
+    if (kind == ENGINE_XOSHIRO256PP) {
+        for (int i = 0; i < 4; i++) {
+            eng->s[i] = splitmix64(&sm);
+        }
+    } else {
+        uint64_t k = splitmix64(&sm);
+        eng->key[0] = (uint32_t)k;
+        eng->key[1] = (uint32_t)(k >> 32);
+    }
+    eng->buf_pos = 2; // Philox block is empty until the first draw
+}
+
+// One Philox4x32-10 block: the two output words of counter c under key k
+static inline void philox_block(const uint32_t c[4], const uint32_t k[2], uint64_t out[2]) {
+    uint32_t c0 = c[0], c1 = c[1], c2 = c[2], c3 = c[3];
+    uint32_t k0 = k[0], k1 = k[1];
+
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = ((uint64_t)c1 << 32) | c0;
+    out[1] = ((uint64_t)c3 << 32) | c2;
+}
+
+// 64-bit block counter in ctr[0..1]; the stream in ctr[2..3] is untouched
+static inline void philox_advance(uint32_t ctr[4]) {
+    if (++ctr[0] == 0) {
+        ++ctr[1];
+    }
+}
+
+void engine_philox_refill(rng_engine_t *eng) {
+    philox_block(eng->ctr, eng->key, eng->buf);
+    eng->buf_pos = 0;
+    philox_advance(eng->ctr);
+}
+
+void engine_fill_u64(rng_engine_t *eng, uint64_t *out, size_t n) {
+    size_t i = 0;
+    if (eng->kind == ENGINE_XOSHIRO256PP) {
+        // Local state: out may not alias it, so it stays in registers
+        uint64_t s0 = eng->s[0], s1 = eng->s[1], s2 = eng->s[2], s3 = eng->s[3];
+        for (; i < n; i++) {
+            out[i] = engine_rotl(s0 + s3, 23) + s0;
+            const uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            s3 = engine_rotl(s3, 45);
+        }
+        eng->s[0] = s0;
+        eng->s[1] = s1;
+        eng->s[2] = s2;
+        eng->s[3] = s3;
+        return;
+    }
+    // Philox: drain the pending word, write whole blocks straight to out,
+    // and leave a last odd word pending as engine_next_u64 would
+    while (i < n && eng->buf_pos < 2) {
+        out[i++] = eng->buf[eng->buf_pos++];
+    }
+    uint32_t ctr[4] = {eng->ctr[0], eng->ctr[1], eng->ctr[2], eng->ctr[3]};
+    for (; i + 2 <= n; i += 2) {
+        philox_block(ctr, eng->key, out + i);
+        philox_advance(ctr);
+    }
+    memcpy(eng->ctr, ctr, sizeof ctr);
+    if (i < n) {
+        engine_philox_refill(eng);
+        out[i] = eng->buf[eng->buf_pos++];
+    }
+}
+
+// Apply a jump polynomial to the xoshiro state
+static void xoshiro_apply_jump(rng_engine_t *eng, const uint64_t poly[4]) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (poly[i] & (UINT64_C(1) << b)) {
+                s0 ^= eng->s[0];
+                s1 ^= eng->s[1];
+                s2 ^= eng->s[2];
+                s3 ^= eng->s[3];
+            }
+            engine_next_u64(eng);
+        }
+    }
+    eng->s[0] = s0;
+    eng->s[1] = s1;
+    eng->s[2] = s2;
+    eng->s[3] = s3;
+}
+
+void engine_jump(rng_engine_t *eng) {
+    if (eng->kind == ENGINE_XOSHIRO256PP) {
+        xoshiro_apply_jump(eng, XOSHIRO_JUMP);
+    } else {
+        // Next stream: bump the high 64 bits of the counter (2^64 blocks ahead)
+        if (++eng->ctr[2] == 0) {
+            ++eng->ctr[3];
+        }
+        eng->buf_pos = 2;
+    }
+    eng->has_spare = 0;
+}
+
+void engine_long_jump(rng_engine_t *eng) {
+    if (eng->kind == ENGINE_XOSHIRO256PP) {
+        xoshiro_apply_jump(eng, XOSHIRO_LONG_JUMP);
+    } else {
+        ++eng->ctr[3];
+        eng->buf_pos = 2;
+    }
+    eng->has_spare = 0;
+}
+
+void engine_substream(rng_engine_t *dst, const rng_engine_t *base, uint64_t k) {
+    *dst = *base;
+    dst->has_spare = 0;
+    if (base->kind == ENGINE_PHILOX4X32) {
+        uint64_t stream = (((uint64_t)base->ctr[3] << 32) | base->ctr[2]) + k;
+        dst->ctr[2] = (uint32_t)stream;
+        dst->ctr[3] = (uint32_t)(stream >> 32);
+        dst->buf_pos = 2;
+        return;
+    }
+    // xoshiro has no O(1) skip: apply the 2^128 jump k times
+    for (uint64_t i = 0; i < k; i++) {
+        engine_jump(dst);
+    }
+}
+
+int engine_kind_from_name(const char *name) {
+    if (strcmp(name, "xoshiro") == 0 || strcmp(name, "xoshiro256++") == 0) {
+        return ENGINE_XOSHIRO256PP;
+    }
+    if (strcmp(name, "philox") == 0 || strcmp(name, "philox4x32") == 0) {
+        return ENGINE_PHILOX4X32;
+    }
+    return -1;
+}
+
+const char *engine_kind_name(engine_kind_t kind) {
+    return kind == ENGINE_XOSHIRO256PP ? "xoshiro256++" : "philox4x32";
+}
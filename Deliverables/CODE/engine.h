@@ -0,0 +1,144 @@
+/******************************************************************************
+ * File: engine.h
+ *
+ * Purpose:
+ * Shared random number engine layer used by every generator in this folder.
+ * Each engine is an explicit handle: there is no hidden global state, so two
+ * threads can each own an engine and runs are reproducible from the seed.
+ *
+ * Engines:
+ * 1. **xoshiro256++**: very fast 64-bit generator with a 2^256 period.
+ *    Jump-ahead moves the state forward by 2^128 draws.
+ * 2. **Philox4x32-10**: counter-based generator. A stream is selected by the
+ *    high half of the counter, so any substream is available in O(1).
+ *
+ * Usage:
+ * - rng_engine_t eng; engine_init(&eng, ENGINE_XOSHIRO256PP, seed);
+ * - engine_substream(&child, &eng, k) gives the k-th independent stream.
+ *
+ *****************************************************************************/
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+    ENGINE_XOSHIRO256PP = 0,
+    ENGINE_PHILOX4X32 = 1
+} engine_kind_t;
+
+typedef struct {
+    engine_kind_t kind;
+    uint64_t seed;      // Seed the engine was initialised with
+    uint64_t s[4];      // xoshiro256++ state
+    uint32_t ctr[4];    // Philox counter (ctr[2..3] select the stream)
+    uint32_t key[2];    // Philox key
+    uint64_t buf[2];    // Philox output block not yet handed out
+    int buf_pos;        // Next unused word in buf (2 = empty)
+    int normal_method;  // Normal sampler used by nrand() (see normal.h)
+    int has_spare;      // Box-Muller: second variate of the last pair is cached
+    double spare;
+} rng_engine_t;
+
+// Initialise an engine of the given kind from a 64-bit seed
+void engine_init(rng_engine_t *eng, engine_kind_t kind, uint64_t seed);
+// Advance the engine to the next independent stream (2^128 draws for xoshiro)
+void engine_jump(rng_engine_t *eng);
+// Advance the engine by 2^192 draws (xoshiro) or 2^32 streams (Philox);
+// use long jumps for outer streams (files) and jumps for inner ones (chunks)
+void engine_long_jump(rng_engine_t *eng);
+// Make dst the k-th substream of base (base is left untouched)
+void engine_substream(rng_engine_t *dst, const rng_engine_t *base, uint64_t k);
+// Refill the Philox output block (internal, used by engine_next_u64)
+void engine_philox_refill(rng_engine_t *eng);
+// out[0..n) = the next n words of engine_next_u64, with the engine kind
+// resolved once and the state kept in registers for the whole run
+void engine_fill_u64(rng_engine_t *eng, uint64_t *out, size_t n);
+// Parse an engine name ("xoshiro" or "philox"); returns -1 if unknown
+int engine_kind_from_name(const char *name);
+// Human readable engine name
+const char *engine_kind_name(engine_kind_t kind);
+
+static inline uint64_t engine_rotl(const uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Next 64 bits of an xoshiro256++ engine (no check of the kind)
+static inline uint64_t engine_next_xoshiro(rng_engine_t *eng) {
+    uint64_t *s = eng->s;
+    const uint64_t result = engine_rotl(s[0] + s[3], 23) + s[0];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = engine_rotl(s[3], 45);
+    return result;
+}
+
+// Next 64 bits of a Philox engine (no check of the kind)
+static inline uint64_t engine_next_philox(rng_engine_t *eng) {
+    if (eng->buf_pos >= 2) {
+        engine_philox_refill(eng);
+    }
+    return eng->buf[eng->buf_pos++];
+}
+
+// Next 64 random bits from the engine. Loops that draw many words should
+// branch on the kind once and call engine_next_xoshiro/_philox directly.
+static inline uint64_t engine_next_u64(rng_engine_t *eng) {
+    if (eng->kind == ENGINE_XOSHIRO256PP) {
+        return engine_next_xoshiro(eng);
+    }
+    return engine_next_philox(eng);
+}
+
+// Map 64 random bits to a double uniformly distributed in [0, 1)
+static inline double engine_bits_to_double(uint64_t x) {
+    uint64_t bits = (x >> 12) | UINT64_C(0x3FF0000000000000);
+    double d;
+    memcpy(&d, &bits, sizeof d);
+    return d - 1.0;
+}
+
+// Random real number uniformly distributed in [0, 1)
+static inline double engine_next_double(rng_engine_t *eng) {
+    return engine_bits_to_double(engine_next_u64(eng));
+}
+
+// Macro for generating random real numbers uniformly in [0, 1)
+#define frand(eng) engine_next_double(eng)
+
+// Threshold below which a multiply-shift draw for range is biased: 2^64 mod range
+static inline uint64_t engine_bounded_threshold(uint64_t range) {
+    return (0 - range) % range;
+}
+
+// Random integer uniformly distributed in [0, range); range 0 stands for 2^64.
+// Lemire's multiply-shift: the high word of x * range, redrawn only when the
+// low word falls in the biased sliver (the division is skipped almost always).
+static inline uint64_t engine_next_bounded(rng_engine_t *eng, uint64_t range) {
+    uint64_t x = engine_next_u64(eng);
+    if (range == 0) {
+        return x;
+    }
+    unsigned __int128 p = (unsigned __int128)x * range;
+    if ((uint64_t)p < range) {
+        uint64_t t = engine_bounded_threshold(range);
+        while ((uint64_t)p < t) {
+            p = (unsigned __int128)engine_next_u64(eng) * range;
+        }
+    }
+    return (uint64_t)(p >> 64);
+}
+
+// Random integer uniformly distributed in [lo, hi] (any 64-bit range)
+static inline int64_t engine_uniform_int(rng_engine_t *eng, int64_t lo, int64_t hi) {
+    uint64_t range = (uint64_t)hi - (uint64_t)lo + 1; // Wraps to 0 for the full range
+    return (int64_t)((uint64_t)lo + engine_next_bounded(eng, range));
+}
+
+#endif
@@ -26,9 +26,13 @@
  * 
  *****************************************************************************/
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 // Number of random numbers to generate
 #define NUM_RANDOMS 100
@@ -83,24 +87,34 @@ void write_random_numbers_to_file(const char *filename, int count) {
 /**
  * Reads the contents of the specified file and displays them on the console.
  * 
- * Each line of the file is printed as it is read.
+ * The file is mapped into memory and written out in one go, instead of
+ * being copied line by line through a small buffer.
  * 
  * Parameters:
  *   filename - Name of the file to read from.
  */
 void read_and_display_file(const char *filename) {
-    FILE *file = fopen(filename, "r"); // Open the file in read mode
-    if (file == NULL) {
+    int fd = open(filename, O_RDONLY); // Open the file in read mode
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
         perror("Error opening file for reading");
         exit(EXIT_FAILURE);
     }
+    if (st.st_size == 0) {
+        close(fd); // Nothing to display
+        return;
+    }
 
-    char line[256]; // Buffer to store each line read from the file
-
-    // Read and print each line of the file
-    while (fgets(line, sizeof(line), file) != NULL) {
-        printf("%s", line); // Print the line to the console
+    // Map the whole file; the mapping stays valid after the descriptor is closed
+    char *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping file");
+        exit(EXIT_FAILURE);
     }
 
-    fclose(file); // Close the file after reading
+    // Print the file contents to the console
+    fwrite(data, 1, (size_t)st.st_size, stdout);
+
+    munmap(data, (size_t)st.st_size); // Release the mapping after reading
 }
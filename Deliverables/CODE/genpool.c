@@ -0,0 +1,817 @@
+/******************************************************************************
+ * File: genpool.c
+ *
+ * Purpose:
+ * Thread pool behind genpool.h. Chunks are handed out in (file, chunk)
+ * order from an atomic counter. A finished chunk waits until the previous
+ * chunk of its file has been committed, then appends its text. Because chunks
+ * are taken in order, the oldest outstanding chunk of a file is always being
+ * worked on, so the wait can never deadlock.
+ *
+ * Appending is only a copy into the file's asynchronous writer (writer.h);
+ * the write() calls run on that writer's I/O thread, so the workers keep
+ * generating while the disk catches up.
+ *
+ * A file with a checkpoint record starts at chunk `first`: the chunks before
+ * it are on disk already and are only generated again when the file wants
+ * summaries (replayed: summarised but not formatted).
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "genpool.h"
+#include "batch.h"
+#include "writer.h"
+#include "dataset.h"
+#include "instr.h"
+
+// Room reserved per formatted sample ("%.6f\n" of |x| < 1e50)
+#define GEN_MAX_LINE 64
+// Initial chunk text buffer: every line plus slack for one worst-case
+// fmt_fixed; a chunk of larger samples grows it
+#define GEN_TEXT_BYTES ((size_t)GEN_CHUNK * GEN_MAX_LINE + FMT_MAX)
+// Version of the checkpoint record and of what its key covers
+#define GEN_CKPT_VERSION 1
+
+// Checkpoint record (genpool.h)
+typedef struct {
+    uint64_t key;
+    int64_t N;                  // Target of the run that wrote it
+    int64_t samples;            // Samples on disk (N: complete)
+    uint64_t text_bytes;        // Text bytes of those samples ...
+    uint64_t chunk_text_bytes;  // ... and of the full chunks among them
+} gen_ckpt_t;
+
+typedef struct {
+    gen_file_t *spec;
+    batch_dist_t dist;       // The file's distribution, constants precomputed
+    qmc_t qmc;               // Quasi-random files: the sequence at point 0
+    int64_t nchunks;
+    int64_t first;           // First chunk to write; earlier ones are on disk
+    int64_t skip;            // Chunks not even replayed (first, unless summaries are wanted)
+    rng_engine_t *chunk_eng; // Start engine of every chunk
+    text_writer_t text_out;  // Asynchronous writers, open from chunk first to the last
+    text_writer_t bin_out;
+    int text_open, bin_open;
+    size_t elem_size;        // Binary element size (int32 or float64)
+    uint64_t key;            // Checkpoint key of the file
+    uint64_t text_bytes;     // Text bytes of the chunks committed so far ...
+    uint64_t chunk_text_bytes; // ... and of the full ones among them
+    int64_t next_commit;     // Next chunk allowed to append
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+    int failed;
+    int stopped;             // A chunk could not be formatted: nothing more is appended
+} gen_state_t;
+
+typedef struct {
+    gen_state_t *files;
+    int nfiles;
+    int64_t *first_chunk;    // Global index of each file's chunk 0 (nfiles + 1 entries)
+    atomic_llong next;       // Next global chunk to hand out
+    atomic_int failed;       // A worker ran out of memory; no more chunks are handed out
+    int max_bins;            // Largest histogram of any file (worker scratch size)
+    uint32_t max_cells;      // Largest goodness-of-fit table of any file (likewise)
+} gen_pool_t;
+
+// Summaries of one chunk, merged into the file's at commit
+typedef struct {
+    stats_acc_t stats;
+    hist_t hist;
+    kll_t sketch;
+    gof_t gof;
+} gen_summary_t;
+
+int genpool_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+double genpool_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Grow the worker's text buffer so that one more worst-case line fits; -1 if out of memory
+static int grow_text(char **text, size_t *cap, size_t len)
+{
+    size_t want = *cap;
+    while (want - len < FMT_MAX + 1)
+    {
+        want *= 2;
+    }
+    char *t = realloc(*text, want);
+    if (t == NULL)
+    {
+        return -1;
+    }
+    *text = t;
+    *cap = want;
+    return 0;
+}
+
+// Generate one chunk into text and/or packed binary, and into the chunk's
+// summaries the file asks for; sets *len to the number of text bytes, -1 if
+// the text buffer could not grow
+static int format_chunk(gen_state_t *st, int64_t chunk, double *vals, char **text, size_t *cap, void *bin,
+                        gen_summary_t *sum, size_t *len_out)
+{
+    const gen_file_t *f = st->spec;
+    rng_engine_t eng = st->chunk_eng[chunk];
+    int64_t start = chunk * GEN_CHUNK;
+    int64_t count = f->N - start < GEN_CHUNK ? f->N - start : GEN_CHUNK;
+    size_t len = 0;
+    int output = chunk >= st->first; // Otherwise a replay for the summaries
+    qmc_t qmc;
+    if (f->sequence != QMC_NONE)
+    {
+        qmc = st->qmc;
+        qmc_seek(&qmc, (uint64_t)start);
+    }
+
+    for (int64_t done = 0; done < count; done += GEN_BLOCK)
+    {
+        int n = count - done < GEN_BLOCK ? (int)(count - done) : GEN_BLOCK;
+        INSTR_TIME_START(t_gen);
+        if (f->sequence != QMC_NONE)
+        {
+            qmc_dist_fill(&qmc, &st->dist, vals, (size_t)n);
+        }
+        else
+        {
+            batch_dist_fill(&st->dist, &eng, vals, (size_t)n);
+        }
+        INSTR_TIME_STOP(t_gen, INSTR_GENERATE);
+        INSTR_TIME_START(t_sum);
+        if (f->stats != NULL)
+        {
+            stats_push_batch(&sum->stats, vals, (size_t)n);
+        }
+        if (f->hist != NULL)
+        {
+            hist_add_batch(&sum->hist, vals, (size_t)n);
+        }
+        if (f->sketch != NULL)
+        {
+            kll_push_batch(&sum->sketch, vals, (size_t)n);
+        }
+        if (f->gof != NULL)
+        {
+            gof_push_batch(&sum->gof, vals, (size_t)n);
+        }
+        INSTR_TIME_STOP(t_sum, INSTR_SUMMARISE);
+        INSTR_TIME_START(t_fmt);
+        if (output && (f->formats & GEN_OUT_BINARY))
+        {
+            if (dist_is_integer(f->type))
+            {
+                int32_t *out = (int32_t *)bin + done;
+                for (int i = 0; i < n; i++)
+                {
+                    out[i] = (int32_t)vals[i];
+                }
+            }
+            else
+            {
+                memcpy((double *)bin + done, vals, (size_t)n * sizeof(double));
+            }
+        }
+        if (output && (f->formats & GEN_OUT_TEXT))
+        {
+            for (int i = 0; i < n; i++)
+            {
+                // Only samples of |x| >= 1e50 run past GEN_MAX_LINE
+                if (*cap - len < FMT_MAX + 1 && grow_text(text, cap, len) != 0)
+                {
+                    return -1;
+                }
+                len += fmt_fixed(*text + len, vals[i], 6);
+                (*text)[len++] = '\n';
+            }
+        }
+        INSTR_TIME_STOP(t_fmt, INSTR_FORMAT);
+    }
+    *len_out = len;
+    return 0;
+}
+
+// FNV-1a over the bytes of n words
+static uint64_t hash_words(const uint64_t *w, size_t n)
+{
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (int b = 0; b < 64; b += 8)
+        {
+            h = (h ^ ((w[i] >> b) & 0xFF)) * UINT64_C(0x100000001b3);
+        }
+    }
+    return h;
+}
+
+static uint64_t double_bits(double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof u);
+    return u;
+}
+
+// Checkpoint key: everything the bytes of the file depend on except N
+static uint64_t file_key(const gen_file_t *f)
+{
+    const rng_engine_t *e = &f->base;
+    uint64_t w[] = {GEN_CKPT_VERSION, GEN_CHUNK, (uint64_t)f->type, (uint64_t)f->formats,
+                    double_bits(f->m), double_bits(f->M), double_bits(f->mu), double_bits(f->sigma),
+                    (uint64_t)e->kind, e->seed, e->s[0], e->s[1], e->s[2], e->s[3],
+                    ((uint64_t)e->ctr[0] << 32) | e->ctr[1], ((uint64_t)e->ctr[2] << 32) | e->ctr[3],
+                    ((uint64_t)e->key[0] << 32) | e->key[1], (uint64_t)e->normal_method,
+                    (uint64_t)f->sequence, f->dimension, f->stream};
+    return hash_words(w, sizeof w / sizeof w[0]);
+}
+
+static int read_checkpoint(const char *path, gen_ckpt_t *c)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    int version = 0;
+    int got = fscanf(fp, "rns checkpoint %d key %" SCNx64 " N %" SCNd64 " samples %" SCNd64
+                         " text_bytes %" SCNu64 " chunk_text_bytes %" SCNu64,
+                     &version, &c->key, &c->N, &c->samples, &c->text_bytes, &c->chunk_text_bytes);
+    fclose(fp);
+    return got == 6 && version == GEN_CKPT_VERSION && c->samples >= 0 && c->samples <= c->N ? 0 : -1;
+}
+
+// Replace the record in one rename(), so it is never seen half written
+static int write_checkpoint(const char *path, const gen_ckpt_t *c)
+{
+    char tmp[sizeof(((gen_file_t *)0)->ckpt_path) + 8]; // path + ".tmp"
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    fprintf(fp, "rns checkpoint %d\nkey %016" PRIx64 "\nN %" PRId64 "\nsamples %" PRId64 "\ntext_bytes %" PRIu64
+                "\nchunk_text_bytes %" PRIu64 "\n",
+            GEN_CKPT_VERSION, c->key, c->N, c->samples, c->text_bytes, c->chunk_text_bytes);
+    if (fclose(fp) != 0 || rename(tmp, path) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Size of path, or -1 if it does not exist
+static int64_t file_size(const char *path)
+{
+    struct stat sb;
+    return stat(path, &sb) == 0 ? (int64_t)sb.st_size : -1;
+}
+
+// Fill the .bin header of a file from its spec
+static void binary_header(const gen_file_t *f, dataset_header_t *hdr)
+{
+    dataset_header_init(hdr, dist_is_integer(f->type) ? DS_INT32 : DS_FLOAT64, (uint64_t)f->N);
+    hdr->distribution = (uint32_t)f->type;
+    hdr->engine = (uint32_t)f->base.kind;
+    hdr->normal_method = (uint32_t)f->base.normal_method;
+    hdr->stream = f->stream;
+    hdr->mu = f->mu;
+    hdr->sigma = f->sigma;
+    hdr->m = f->m;
+    hdr->M = f->M;
+    hdr->seed = f->base.seed;
+    hdr->sequence = (uint32_t)f->sequence;
+    hdr->dimension = f->dimension;
+}
+
+// Byte offset of a text file just past its first `lines` lines; -1 if it has fewer
+static int line_offset(const char *path, int64_t lines, uint64_t *offset)
+{
+    int fd = open(path, O_RDONLY);
+    char *buf = malloc(WRITER_BUFFER);
+    uint64_t pos = 0;
+    ssize_t r = 0;
+    while (lines > 0 && fd >= 0 && buf != NULL && (r = read(fd, buf, WRITER_BUFFER)) > 0)
+    {
+        for (char *p = buf, *end = buf + r; lines > 0 && (p = memchr(p, '\n', (size_t)(end - p))) != NULL;)
+        {
+            p++;
+            lines--;
+            if (lines == 0)
+            {
+                pos += (uint64_t)(p - buf);
+            }
+        }
+        pos += lines > 0 ? (uint64_t)r : 0;
+    }
+    free(buf);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    *offset = pos;
+    return lines == 0 ? 0 : -1;
+}
+
+// Work out from the file's record how much of it can stay: all of it (first
+// = nchunks, kept = N) or its full chunks, as many as N still covers (first
+// = their count); 0 if none. Done before any output is touched, so the
+// record always matches the disk.
+static int plan_resume(gen_state_t *st)
+{
+    gen_file_t *f = st->spec;
+    int text = (f->formats & GEN_OUT_TEXT) != 0, bin = (f->formats & GEN_OUT_BINARY) != 0;
+    gen_ckpt_t c;
+    int64_t full = 0;
+    uint64_t full_text = 0; // Text bytes of the full chunks kept
+
+    st->key = file_key(f);
+    if (read_checkpoint(f->ckpt_path, &c) == 0 && c.key == st->key)
+    {
+        int64_t text_size = file_size(f->path), bin_size = file_size(f->bin_path);
+        int64_t bin_head = (int64_t)sizeof(dataset_header_t);
+        if (c.samples == c.N && c.N == f->N && (!text || text_size == (int64_t)c.text_bytes) &&
+            (!bin || bin_size == bin_head + f->N * (int64_t)st->elem_size))
+        {
+            // Up to date
+            st->first = st->nchunks;
+            f->kept = f->N;
+            return 0;
+        }
+        // A partial last chunk is not a prefix of the full chunk (rejection
+        // sampling draws ahead), so only whole chunks carry over
+        full = c.samples / GEN_CHUNK;
+        full_text = c.chunk_text_bytes;
+        if ((text && text_size < (int64_t)c.chunk_text_bytes) ||
+            (bin && bin_size < bin_head + full * GEN_CHUNK * (int64_t)st->elem_size))
+        {
+            full = 0;
+        }
+        else if (full * GEN_CHUNK > f->N)
+        {
+            // N shrank: keep the full chunks it still covers. The record only
+            // has the text offset of the last one, so count lines for the new end.
+            full = f->N / GEN_CHUNK;
+            if (text && line_offset(f->path, full * GEN_CHUNK, &full_text) != 0)
+            {
+                full = 0;
+            }
+        }
+    }
+    if (full == 0)
+    {
+        // Starting over: drop the record before the outputs are truncated
+        if (unlink(f->ckpt_path) != 0 && errno != ENOENT)
+        {
+            perror(f->ckpt_path);
+            return -1;
+        }
+        return 0;
+    }
+    if (full == st->nchunks)
+    {
+        // Long enough already (N shrank to a chunk boundary): only the end goes
+        dataset_header_t hdr;
+        binary_header(f, &hdr);
+        int fd = bin ? dataset_extend(f->bin_path, &hdr, (uint64_t)f->N) : -1;
+        if ((bin && (fd < 0 || close(fd) != 0)) || (text && truncate(f->path, (off_t)full_text) != 0))
+        {
+            perror(f->path);
+            return -1;
+        }
+    }
+    st->first = full;
+    st->text_bytes = full_text;
+    st->chunk_text_bytes = full_text;
+    f->kept = full == st->nchunks ? f->N : full * GEN_CHUNK;
+    gen_ckpt_t kept = {st->key, f->N, f->kept, full_text, full_text};
+    if (write_checkpoint(f->ckpt_path, &kept) != 0)
+    {
+        perror(f->ckpt_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Create the .bin file and write its header, or reopen it after the kept chunks
+static int open_binary(gen_state_t *st)
+{
+    const gen_file_t *f = st->spec;
+    dataset_header_t hdr;
+    binary_header(f, &hdr);
+    int fd = st->first == 0 ? dataset_create(f->bin_path, &hdr)
+                            : dataset_extend(f->bin_path, &hdr, (uint64_t)(st->first * GEN_CHUNK));
+    if (fd < 0 || writer_attach(&st->bin_out, fd) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    st->bin_out.owns_fd = 1;
+    writer_start_async(&st->bin_out); // Stays synchronous if the thread cannot start
+    st->bin_open = 1;
+    return 0;
+}
+
+// Create the text file, or reopen it after the kept chunks
+static int open_text(gen_state_t *st)
+{
+    const gen_file_t *f = st->spec;
+    if (st->first == 0)
+    {
+        return writer_open(&st->text_out, f->path);
+    }
+    int fd = open(f->path, O_WRONLY);
+    if (fd < 0 || ftruncate(fd, (off_t)st->text_bytes) != 0 || lseek(fd, 0, SEEK_END) < 0 ||
+        writer_attach(&st->text_out, fd) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    st->text_out.owns_fd = 1;
+    return 0;
+}
+
+// Wait for the I/O thread of one output and close it
+static void close_output(gen_state_t *st, text_writer_t *w, int *open, const char *path)
+{
+    if (writer_close(w) != 0)
+    {
+        fprintf(stderr, "%s: write failed\n", path);
+        st->failed = 1;
+    }
+    *open = 0;
+}
+
+// Get everything appended so far onto the disk, then say so in the record
+static void checkpoint(gen_state_t *st, int64_t samples)
+{
+    const gen_file_t *f = st->spec;
+    INSTR_TIME_START(t_ckpt);
+    if ((st->bin_open && writer_sync(&st->bin_out) != 0) || (st->text_open && writer_sync(&st->text_out) != 0))
+    {
+        fprintf(stderr, "%s: write failed\n", f->path);
+        st->failed = 1;
+    }
+    if (!st->failed)
+    {
+        gen_ckpt_t c = {st->key, f->N, samples, st->text_bytes, st->chunk_text_bytes};
+        if (write_checkpoint(f->ckpt_path, &c) != 0)
+        {
+            perror(f->ckpt_path); // The data is fine; the next run just redoes more of it
+        }
+    }
+    INSTR_TIME_STOP(t_ckpt, INSTR_CHECKPOINT);
+}
+
+// Append a generated chunk to the outputs, which open at the first one
+static void append_chunk(gen_state_t *st, int64_t chunk, const char *text, size_t len, const void *bin)
+{
+    const gen_file_t *f = st->spec;
+    int64_t count = f->N - chunk * GEN_CHUNK < GEN_CHUNK ? f->N - chunk * GEN_CHUNK : GEN_CHUNK;
+    int last = chunk == st->nchunks - 1;
+    if (chunk == st->first && (f->formats & GEN_OUT_BINARY) && open_binary(st) != 0)
+    {
+        st->failed = 1;
+    }
+    if (st->bin_open)
+    {
+        writer_put(&st->bin_out, bin, (size_t)count * st->elem_size);
+    }
+    if (chunk == st->first && (f->formats & GEN_OUT_TEXT))
+    {
+        if (open_text(st) != 0)
+        {
+            perror(f->path);
+            st->failed = 1;
+        }
+        else
+        {
+            writer_start_async(&st->text_out);
+            st->text_open = 1;
+        }
+    }
+    if (st->text_open)
+    {
+        // Only a copy here: the I/O thread does the write() while generation goes on
+        writer_put(&st->text_out, text, len);
+    }
+    st->text_bytes += len;
+    if (count == GEN_CHUNK)
+    {
+        st->chunk_text_bytes = st->text_bytes;
+    }
+    if (f->ckpt_path[0] != '\0' && (last || (chunk + 1) % GEN_CKPT_CHUNKS == 0))
+    {
+        checkpoint(st, last ? f->N : (chunk + 1) * GEN_CHUNK);
+    }
+    if (last && st->bin_open)
+    {
+        close_output(st, &st->bin_out, &st->bin_open, f->bin_path);
+    }
+    if (last && st->text_open)
+    {
+        close_output(st, &st->text_out, &st->text_open, f->path);
+    }
+}
+
+// Merge a chunk's summaries and append it once all earlier chunks of the file are committed
+// (formatted 0: the chunk's text could not be built, so the file stops there)
+static void commit_chunk(gen_state_t *st, int64_t chunk, const char *text, size_t len, const void *bin,
+                         const gen_summary_t *sum, int formatted)
+{
+    const gen_file_t *f = st->spec;
+    INSTR_TIME_START(t_wait);
+    pthread_mutex_lock(&st->lock);
+    while (st->next_commit != chunk)
+    {
+        pthread_cond_wait(&st->turn, &st->lock);
+    }
+    INSTR_TIME_STOP(t_wait, INSTR_COMMIT_WAIT);
+    if (!formatted && !st->stopped)
+    {
+        fprintf(stderr, "%s: out of memory formatting chunk %lld\n", f->path, (long long)chunk);
+        st->failed = 1;
+        st->stopped = 1;
+    }
+    // Once stopped, later chunks (already handed out) only pass through, so the file has no gap
+    if (!st->stopped)
+    {
+        if (f->stats != NULL)
+        {
+            stats_merge(f->stats, &sum->stats);
+        }
+        if (f->hist != NULL)
+        {
+            hist_merge(f->hist, &sum->hist);
+        }
+        if (f->sketch != NULL && kll_merge(f->sketch, &sum->sketch) != 0)
+        {
+            fprintf(stderr, "Out of memory\n");
+            st->failed = 1;
+        }
+        if (f->gof != NULL)
+        {
+            gof_merge(f->gof, &sum->gof);
+        }
+        if (chunk >= st->first)
+        {
+            append_chunk(st, chunk, text, len, bin);
+        }
+    }
+    if (chunk == st->nchunks - 1)
+    {
+        st->spec->finished = genpool_now();
+    }
+    st->next_commit++;
+    pthread_cond_broadcast(&st->turn);
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void *gen_worker(void *arg)
+{
+    gen_pool_t *pool = arg;
+    int64_t total = pool->first_chunk[pool->nfiles];
+    double *vals = malloc(GEN_BLOCK * sizeof(double));
+    size_t cap = GEN_TEXT_BYTES;
+    char *text = malloc(cap);
+    void *bin = malloc((size_t)GEN_CHUNK * sizeof(double));
+    uint64_t *counts = calloc((size_t)pool->max_bins, sizeof(uint64_t));
+    uint64_t *cells = calloc((size_t)pool->max_cells + 2, sizeof(uint64_t));
+    int file = 0;
+
+    if (vals == NULL || text == NULL || bin == NULL || counts == NULL || cells == NULL)
+    {
+        // Stop the pool; chunks already handed out are finished by their workers
+        fprintf(stderr, "Out of memory\n");
+        atomic_store(&pool->failed, 1);
+        atomic_store(&pool->next, total);
+    }
+
+    while (!atomic_load(&pool->failed))
+    {
+        int64_t g = atomic_fetch_add(&pool->next, 1);
+        if (g >= total)
+        {
+            break;
+        }
+        while (g >= pool->first_chunk[file + 1])
+        {
+            file++;
+        }
+        gen_state_t *st = &pool->files[file];
+        int64_t chunk = g - pool->first_chunk[file] + st->skip;
+        if (chunk == st->skip)
+        {
+            st->spec->started = genpool_now(); // Chunks are taken in order: this is the file's first
+        }
+
+        // Chunk-local summaries, merged into the file's at commit
+        gen_summary_t sum;
+        const gen_file_t *f = st->spec;
+        stats_init(&sum.stats);
+        if (f->hist != NULL)
+        {
+            sum.hist = *f->hist;
+            sum.hist.counts = counts;
+            sum.hist.below = 0;
+            sum.hist.above = 0;
+            memset(counts, 0, (size_t)sum.hist.bins * sizeof(uint64_t));
+        }
+        if (f->sketch != NULL)
+        {
+            kll_init(&sum.sketch, f->sketch->k);
+        }
+        if (f->gof != NULL)
+        {
+            // Same target and cells; only the counts are private
+            sum.gof = *f->gof;
+            sum.gof.counts = cells;
+            sum.gof.n = 0;
+            memset(cells, 0, ((size_t)sum.gof.cells + 2) * sizeof(uint64_t));
+        }
+        size_t len = 0;
+        int formatted = format_chunk(st, chunk, vals, &text, &cap, bin, &sum, &len) == 0;
+        if (!formatted)
+        {
+            atomic_store(&pool->next, total); // No more chunks for anyone
+        }
+        commit_chunk(st, chunk, text, len, bin, &sum, formatted);
+        if (f->sketch != NULL)
+        {
+            kll_free(&sum.sketch);
+        }
+    }
+    free(cells);
+    free(counts);
+    free(vals);
+    free(text);
+    free(bin);
+    return NULL;
+}
+
+// Set up file i of the pool; its lock is initialised first, so genpool_run
+// cleans up every file it called this for, whether it failed or not
+static int init_file(gen_pool_t *pool, gen_file_t *files, int i)
+{
+    gen_state_t *st = &pool->files[i];
+    gen_file_t *f = &files[i];
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->turn, NULL);
+    st->spec = f;
+    st->elem_size = dist_is_integer(f->type) ? sizeof(int32_t) : sizeof(double);
+    if (f->hist != NULL && f->hist->bins > pool->max_bins)
+    {
+        pool->max_bins = f->hist->bins;
+    }
+    if (f->gof != NULL && f->gof->cells > pool->max_cells)
+    {
+        pool->max_cells = f->gof->cells;
+    }
+    if (f->formats == 0)
+    {
+        f->formats = GEN_OUT_TEXT;
+    }
+    if (batch_dist_init(&st->dist, f->type, f->m, f->M, f->mu, f->sigma) != 0)
+    {
+        fprintf(stderr, "%s: empty truncation window or integer range outside int32\n", f->path);
+        return -1;
+    }
+    if (f->sequence != QMC_NONE)
+    {
+        // The scrambling comes from the file's stream, so it changes with the seed
+        rng_engine_t e = f->base;
+        if (qmc_init(&st->qmc, f->sequence, f->dimension, engine_next_u64(&e)) != 0)
+        {
+            fprintf(stderr, "%s: %s has no coordinate %u\n", f->path, qmc_kind_name(f->sequence), f->dimension);
+            return -1;
+        }
+        if ((uint64_t)f->N > QMC_MAX_POINTS)
+        {
+            fprintf(stderr, "%s: more samples than %s has points\n", f->path, qmc_kind_name(f->sequence));
+            return -1;
+        }
+    }
+    // An empty file still gets one (empty) chunk so that it is created
+    st->nchunks = f->N > 0 ? (f->N + GEN_CHUNK - 1) / GEN_CHUNK : 1;
+    f->kept = 0;
+    if (f->ckpt_path[0] != '\0' && plan_resume(st) != 0)
+    {
+        return -1;
+    }
+    // Kept chunks are only replayed for the summaries
+    int summaries = f->stats != NULL || f->hist != NULL || f->sketch != NULL || f->gof != NULL;
+    st->skip = summaries ? 0 : st->first;
+    st->next_commit = st->skip;
+    if (st->skip == st->nchunks)
+    {
+        f->started = f->finished = genpool_now(); // Nothing to do
+    }
+    st->chunk_eng = malloc((size_t)st->nchunks * sizeof(rng_engine_t));
+    if (st->chunk_eng == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    // Chunk start states: one jump per chunk, computed once up front
+    rng_engine_t e = f->base;
+    for (int64_t k = 0; k < st->nchunks; k++)
+    {
+        st->chunk_eng[k] = e;
+        engine_jump(&e);
+    }
+    pool->first_chunk[i + 1] = pool->first_chunk[i] + st->nchunks - st->skip;
+    return 0;
+}
+
+int genpool_run(gen_file_t *files, int nfiles, int threads)
+{
+    gen_pool_t pool;
+    int rc = 0;
+
+    pool.nfiles = nfiles;
+    pool.files = calloc((size_t)nfiles, sizeof(gen_state_t));
+    pool.first_chunk = calloc((size_t)nfiles + 1, sizeof(int64_t));
+    if (pool.files == NULL || pool.first_chunk == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        free(pool.files);
+        free(pool.first_chunk);
+        return -1;
+    }
+    atomic_init(&pool.next, 0);
+    atomic_init(&pool.failed, 0);
+    pool.max_bins = 1;
+    pool.max_cells = 0;
+
+    int ready = 0; // Files init_file was called for
+    while (rc == 0 && ready < nfiles)
+    {
+        rc = init_file(&pool, files, ready++);
+    }
+
+    if (rc == 0)
+    {
+        // Threads that cannot be started leave their share to the others
+        pthread_t *tids = threads > 1 ? malloc((size_t)threads * sizeof(pthread_t)) : NULL;
+        int started = 1;
+        for (int t = 1; tids != NULL && t < threads; t++, started++)
+        {
+            if (pthread_create(&tids[t], NULL, gen_worker, &pool) != 0)
+            {
+                break;
+            }
+        }
+        gen_worker(&pool); // The calling thread works too
+        for (int t = 1; t < started; t++)
+        {
+            pthread_join(tids[t], NULL);
+        }
+        free(tids);
+    }
+
+    for (int i = 0; i < ready; i++)
+    {
+        gen_state_t *st = &pool.files[i];
+        // A stopped run leaves outputs open; what they hold is still a valid prefix
+        if (st->bin_open)
+        {
+            close_output(st, &st->bin_out, &st->bin_open, st->spec->bin_path);
+        }
+        if (st->text_open)
+        {
+            close_output(st, &st->text_out, &st->text_open, st->spec->path);
+        }
+        rc |= st->failed || atomic_load(&pool.failed) ? -1 : 0;
+        batch_dist_free(&st->dist);
+        free(st->chunk_eng);
+        pthread_mutex_destroy(&st->lock);
+        pthread_cond_destroy(&st->turn);
+    }
+    free(pool.files);
+    free(pool.first_chunk);
+    return rc;
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * File: genpool.h
+ *
+ * Purpose:
+ * Parallel, deterministic generation of data files. Every file is split
+ * into fixed-size chunks; chunk k of a file always draws from the k-th jump
+ * of that file's engine, so the bytes written depend only on the seed and
+ * never on the number of threads or on which thread ran which chunk. Files
+ * with a quasi-random sequence (qmc.h) instead take points k * GEN_CHUNK
+ * onwards, which is just as independent of the schedule.
+ *
+ * Threads take chunks from one shared queue (all files, in order), generate
+ * and format them in private buffers, and append them to their file in
+ * chunk order.
+ *
+ * Pipeline: a file may also name a stats accumulator, a histogram, a
+ * quantile sketch and a goodness-of-fit table. Each block is then folded
+ * into them right after it is generated, while it is still in cache, and
+ * the per-chunk results are merged in chunk order at commit time, so they
+ * too are independent of the thread count.
+ *
+ * Checkpoints: a file with a ckpt_path keeps a small record there of what
+ * is safely on disk: a key over everything its bytes depend on except N
+ * (type, parameters, engine state, normal method, sequence, formats), the
+ * target N, the samples written and the text offsets. Every
+ * GEN_CKPT_CHUNKS chunks the outputs are fdatasync()ed and the record is
+ * replaced. Since chunk k is fully determined by the key and k (its engine
+ * is the k-th jump of base), the record is all the state a later run needs:
+ * with the same key it skips a file already complete for its N, resumes an
+ * interrupted one after its last checkpoint, and otherwise cuts the file
+ * after the last full chunk that both runs share and appends from there, so
+ * a larger N extends the file and a smaller one keeps its leading chunks. The
+ * result is byte-identical to an uninterrupted run. Pipeline summaries are
+ * not stored: the chunks kept are generated again for them, but not
+ * formatted or written.
+ *
+ *****************************************************************************/
+#ifndef GENPOOL_H
+#define GENPOOL_H
+
+#include <stdint.h>
+
+#include "dist.h"
+#include "engine.h"
+#include "gof.h"
+#include "hist.h"
+#include "kll.h"
+#include "qmc.h"
+#include "stats.h"
+
+// Samples per chunk. Part of the output definition: changing it changes the data.
+#define GEN_CHUNK 65536
+// Samples generated per batch call inside a chunk
+#define GEN_BLOCK 4096
+
+// Chunks between checkpoints (512Ki samples)
+#define GEN_CKPT_CHUNKS 8
+
+// Output formats (bit mask for gen_file_t.formats)
+#define GEN_OUT_TEXT 1   // path: one "%.6f" sample per line
+#define GEN_OUT_BINARY 2 // bin_path: dataset.h format
+
+typedef struct {
+    char path[256];
+    char bin_path[256];
+    int formats;       // GEN_OUT_TEXT | GEN_OUT_BINARY (0 means text only)
+    uint32_t stream;   // Stream number recorded in the binary header
+    dist_type_t type;
+    double m, M, mu, sigma;
+    int64_t N;
+    rng_engine_t base; // Chunk k uses this engine advanced by k jumps
+    qmc_kind_t sequence; // QMC_NONE draws from base; otherwise sample i is point i of
+    uint32_t dimension;  // this coordinate of the sequence, scrambled from base's seed
+    stats_acc_t *stats; // If set, every sample is also folded in here
+    hist_t *hist;       // If set, every sample is also binned here
+    kll_t *sketch;      // If set, every sample is also summarised here
+    gof_t *gof;         // If set, every sample is also tested against the target here
+    char ckpt_path[256]; // If set, the checkpoint record of the file (see above)
+    int64_t kept;       // Set by genpool_run: samples reused from an earlier run
+    double started;     // Set by genpool_run: genpool_now() when the first chunk was taken
+    double finished;    // ... and when the last chunk was written
+} gen_file_t;
+
+// Generate all files using the given number of threads; 0 on success
+int genpool_run(gen_file_t *files, int nfiles, int threads);
+// Number of online CPUs (at least 1)
+int genpool_default_threads(void);
+// Monotonic wall-clock time in seconds
+double genpool_now(void);
+
+#endif
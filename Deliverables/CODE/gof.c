@@ -0,0 +1,275 @@
+/******************************************************************************
+ * File: gof.c
+ *
+ * Purpose:
+ * Target CDFs, cell counting and the Kolmogorov-Smirnov / chi-square
+ * statistics (with their p-values) for gof.h.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gof.h"
+#include "truncnorm.h"
+
+// Integer support of an integer target; -1 if it is empty or not integer
+static int integer_support(const gof_t *g, int64_t *lo, int64_t *hi) {
+    double l, h;
+    if (g->type == DIST_NORMAL_INT) {
+        l = floor(g->mu - GOF_NORMAL_SPAN * g->sigma);
+        h = ceil(g->mu + GOF_NORMAL_SPAN * g->sigma);
+    } else {
+        l = ceil(g->m);
+        h = floor(g->M);
+    }
+    if (!(l <= h) || l < -9e15 || h > 9e15) {
+        return -1;
+    }
+    *lo = (int64_t)l;
+    *hi = (int64_t)h;
+    return 0;
+}
+
+double gof_target_cdf(const gof_t *g, double x) {
+    double u;
+    switch (g->type) {
+    case DIST_UNIFORM_REAL:
+        u = (x - g->m) / (g->M - g->m);
+        break;
+    case DIST_UNIFORM_INT:
+        u = (floor(x) - ceil(g->m) + 1) / (floor(g->M) - ceil(g->m) + 1);
+        break;
+    case DIST_NORMAL_REAL:
+    case DIST_NORMAL_INT:
+        // Integer normals are round(N(mu, sigma)): F(k + 0.5) is the normal CDF there
+        u = normal_cdf((x - g->mu) / g->sigma);
+        break;
+    default: {
+        double z = (x - g->mu) / g->sigma;
+        if (z <= g->a) {
+            return 0;
+        }
+        if (z >= g->b) {
+            return 1;
+        }
+        // Mass from the nearer tail, as in truncnorm.c
+        u = g->a > 0 ? (normal_cdf(-g->a) - normal_cdf(-z)) / g->mass : (normal_cdf(z) - normal_cdf(g->a)) / g->mass;
+        break;
+    }
+    }
+    return u < 0 ? 0 : (u > 1 ? 1 : u);
+}
+
+int gof_init(gof_t *g, dist_type_t type, double m, double M, double mu, double sigma, int cells) {
+    memset(g, 0, sizeof *g);
+    g->type = type;
+    g->m = m;
+    g->M = M;
+    g->mu = mu;
+    g->sigma = sigma;
+    g->integer = dist_is_integer(type);
+    if (type < DIST_UNIFORM_INT || type > DIST_TRUNC_INT) {
+        return -1;
+    }
+    if ((type == DIST_UNIFORM_REAL || type == DIST_UNIFORM_INT) ? !(m < M || (g->integer && m == M))
+                                                                : !(sigma > 0)) {
+        return -1;
+    }
+    if (type == DIST_TRUNC_REAL || type == DIST_TRUNC_INT) {
+        // Integer windows hold the reals that round into [m, M]
+        double lo = g->integer ? ceil(m) - 0.5 : m;
+        double hi = g->integer ? floor(M) + 0.5 : M;
+        g->a = (lo - mu) / sigma;
+        g->b = (hi - mu) / sigma;
+        g->mass = g->a > 0 ? normal_cdf(-g->a) - normal_cdf(-g->b) : normal_cdf(g->b) - normal_cdf(g->a);
+        if (!(g->mass > 0)) {
+            return -1;
+        }
+    }
+
+    int max_cells = cells > 0 ? cells : GOF_CELLS;
+    if (g->integer) {
+        int64_t lo, hi;
+        if (integer_support(g, &lo, &hi) != 0) {
+            return -1;
+        }
+        uint64_t span = (uint64_t)(hi - lo) + 1;
+        g->lo = lo;
+        g->width = (int64_t)((span + (uint64_t)max_cells - 1) / (uint64_t)max_cells);
+        g->cells = (uint32_t)((span + (uint64_t)g->width - 1) / (uint64_t)g->width);
+    } else {
+        g->cells = (uint32_t)max_cells;
+    }
+
+    g->edge = malloc((g->cells + 1) * sizeof(double));
+    g->counts = calloc(g->cells + 2, sizeof(uint64_t));
+    if (g->edge == NULL || g->counts == NULL) {
+        gof_free(g);
+        return -1;
+    }
+    for (uint32_t j = 0; j <= g->cells; j++) {
+        // Integer cell j starts at value lo + j * width, so its lower boundary is half a unit below
+        g->edge[j] = g->integer ? gof_target_cdf(g, (double)(g->lo + (int64_t)j * g->width) - 0.5)
+                                : (double)j / g->cells;
+    }
+    return 0;
+}
+
+void gof_free(gof_t *g) {
+    free(g->edge);
+    free(g->counts);
+    g->edge = NULL;
+    g->counts = NULL;
+}
+
+void gof_push_batch(gof_t *g, const double *x, size_t n) {
+    uint64_t *counts = g->counts;
+    if (g->integer) {
+        double lo = (double)g->lo;
+        for (size_t i = 0; i < n; i++) {
+            double v = x[i] - lo;
+            if (v < 0) {
+                counts[0]++;
+                continue;
+            }
+            uint64_t cell = (uint64_t)v / (uint64_t)g->width;
+            counts[cell < g->cells ? cell + 1 : g->cells + 1]++;
+        }
+    } else {
+        // Outside the support of a bounded target counts as below / above
+        int bounded = g->type != DIST_NORMAL_REAL;
+        for (size_t i = 0; i < n; i++) {
+            if (bounded && x[i] < g->m) {
+                counts[0]++;
+            } else if (bounded && x[i] > g->M) {
+                counts[g->cells + 1]++;
+            } else {
+                uint32_t cell = (uint32_t)(gof_target_cdf(g, x[i]) * g->cells);
+                counts[(cell < g->cells ? cell : g->cells - 1) + 1]++;
+            }
+        }
+    }
+    g->n += n;
+}
+
+void gof_merge(gof_t *into, const gof_t *from) {
+    for (uint32_t j = 0; j < from->cells + 2; j++) {
+        into->counts[j] += from->counts[j];
+    }
+    into->n += from->n;
+}
+
+// Asymptotic Kolmogorov survival function Q(lambda)
+static double kolmogorov_q(double lambda) {
+    if (lambda < 0.2) {
+        return 1;
+    }
+    double sum = 0, sign = 1, prev = 0;
+    for (int k = 1; k <= 100; k++) {
+        double term = 2 * sign * exp(-2 * k * k * lambda * lambda);
+        sum += term;
+        if (fabs(term) <= 1e-10 * prev || fabs(term) <= 1e-16 * sum) {
+            return sum < 0 ? 0 : (sum > 1 ? 1 : sum);
+        }
+        sign = -sign;
+        prev = fabs(term);
+    }
+    return 1;
+}
+
+double gof_ks(const gof_t *g, double *p) {
+    if (g->n == 0) {
+        *p = NAN;
+        return NAN;
+    }
+    double n = (double)g->n, d = 0;
+    uint64_t cum = 0;
+    for (uint32_t j = 0; j <= g->cells; j++) {
+        // counts[0..j] are the samples below boundary j
+        cum += g->counts[j];
+        double diff = fabs((double)cum / n - g->edge[j]);
+        d = diff > d ? diff : d;
+    }
+    double en = sqrt(n);
+    *p = kolmogorov_q((en + 0.12 + 0.11 / en) * d);
+    return d;
+}
+
+// Regularised upper incomplete gamma Q(a, x) (series or continued fraction)
+static double gamma_q(double a, double x) {
+    if (!(x > 0)) {
+        return 1;
+    }
+    double front = exp(-x + a * log(x) - lgamma(a));
+    if (x < a + 1) {
+        double ap = a, del = 1 / a, sum = del;
+        for (int i = 0; i < 100000 && fabs(del) > fabs(sum) * 1e-15; i++) {
+            ap += 1;
+            del *= x / ap;
+            sum += del;
+        }
+        double q = 1 - sum * front;
+        return q < 0 ? 0 : q;
+    }
+    // Modified Lentz
+    double b = x + 1 - a, c = 1e300, d = 1 / b, h = d;
+    for (int i = 1; i < 100000; i++) {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        d = fabs(d) < 1e-300 ? 1e-300 : d;
+        c = b + an / c;
+        c = fabs(c) < 1e-300 ? 1e-300 : c;
+        d = 1 / d;
+        double del = d * c;
+        h *= del;
+        if (fabs(del - 1) < 1e-15) {
+            break;
+        }
+    }
+    return front * h;
+}
+
+double gof_chi2(const gof_t *g, int *df, double *p) {
+    double n = (double)g->n;
+    double chi2 = 0, obs = 0, expct = 0, last_obs = 0, last_exp = 0;
+    int groups = 0, impossible = 0;
+    for (uint32_t j = 0; j < g->cells + 2; j++) {
+        // Cell j (below, the cells, above) covers [edge[j - 1], edge[j]] of the target CDF
+        double lo = j == 0 ? 0 : g->edge[j - 1];
+        double hi = j <= g->cells ? g->edge[j] : 1;
+        double e = n * (hi - lo);
+        if (!(e > 0) && g->counts[j] > 0) {
+            impossible = 1; // Samples where the target has no mass
+        }
+        obs += (double)g->counts[j];
+        expct += e > 0 ? e : 0;
+        if (expct >= GOF_MIN_EXPECTED) {
+            chi2 += (obs - expct) * (obs - expct) / expct;
+            last_obs = obs;
+            last_exp = expct;
+            groups++;
+            obs = 0;
+            expct = 0;
+        }
+    }
+    if (groups > 0 && (obs > 0 || expct > 0)) {
+        // The leftover tail joins the last full group
+        chi2 -= (last_obs - last_exp) * (last_obs - last_exp) / last_exp;
+        last_obs += obs;
+        last_exp += expct;
+        chi2 += (last_obs - last_exp) * (last_obs - last_exp) / last_exp;
+    }
+    *df = groups - 1;
+    if (impossible) {
+        *p = 0;
+        return INFINITY;
+    }
+    if (groups < 2) {
+        *p = NAN;
+        return NAN;
+    }
+    *p = gamma_q(*df / 2.0, chi2 / 2);
+    return chi2;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * File: gof.h
+ *
+ * Purpose:
+ * Streaming goodness of fit of generated samples against the distribution
+ * they were drawn from (uniform, normal or truncated normal; real or
+ * integer). Samples are counted into fixed cells whose target probability
+ * is known, so memory is bounded by the number of cells and two
+ * accumulators merge by adding counts. From the counts:
+ *
+ * - Kolmogorov-Smirnov: D = max |F_n - F| over the cell boundaries. For
+ *   integer targets with one value per cell this is the exact statistic of
+ *   the discrete CDF; otherwise it is within one cell of the exact D (the
+ *   true D is at most D + 1/cells for real targets). The p-value uses the
+ *   asymptotic Kolmogorov distribution (conservative for discrete targets).
+ * - Pearson chi-square over the cells, with neighbouring cells pooled until
+ *   each expects at least GOF_MIN_EXPECTED samples.
+ *
+ * Real targets are counted in probability space: the cell of x is
+ * floor(F(x) * cells), so every cell is equally likely. Integer targets use
+ * runs of consecutive values (one value per cell when the support fits),
+ * plus one cell each for values below and above the support.
+ *
+ *****************************************************************************/
+#ifndef GOF_H
+#define GOF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dist.h"
+
+// Default number of cells (KS resolution 1 / GOF_CELLS for real targets)
+#define GOF_CELLS 16384
+// Pooled chi-square cells expect at least this many samples
+#define GOF_MIN_EXPECTED 5
+// Untruncated integer normals are counted over mu +/- GOF_NORMAL_SPAN sigma
+#define GOF_NORMAL_SPAN 10
+
+typedef struct {
+    dist_type_t type;
+    double m, M, mu, sigma; // Target parameters, as in gen_file_t
+    int integer;            // Integer target: cells are runs of values
+    int64_t lo;             // Integer targets: first value of cell 0 ...
+    int64_t width;          // ... and values per cell
+    uint32_t cells;
+    double *edge;           // Target CDF at the cell boundaries (cells + 1 entries)
+    uint64_t *counts;       // cells + 2 entries: below, the cells, above
+    uint64_t n;
+    double a, b, mass;      // Truncated targets: standardised window and its mass
+} gof_t;
+
+// Set up an accumulator for the target; cells <= 0 means GOF_CELLS; -1 on error
+int gof_init(gof_t *g, dist_type_t type, double m, double M, double mu, double sigma, int cells);
+void gof_free(gof_t *g);
+// Count a block of samples
+void gof_push_batch(gof_t *g, const double *x, size_t n);
+// Add the counts of from (same target) into into
+void gof_merge(gof_t *into, const gof_t *from);
+// Kolmogorov-Smirnov D; its p-value in *p (either may be NaN when empty)
+double gof_ks(const gof_t *g, double *p);
+// Pearson chi-square statistic; degrees of freedom in *df and p-value in *p
+double gof_chi2(const gof_t *g, int *df, double *p);
+// Target CDF at x
+double gof_target_cdf(const gof_t *g, double x);
+
+#endif
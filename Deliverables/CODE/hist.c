@@ -0,0 +1,210 @@
+/******************************************************************************
+ * File: hist.c
+ *
+ * Purpose:
+ * Binning kernels, the threaded driver and output for the histograms in
+ * hist.h.
+ *
+ *****************************************************************************/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hist.h"
+
+// Cache line size assumed for the per-thread counters
+#define HIST_LINE 64
+// Below this many samples per thread, starting threads costs more than it saves
+#define HIST_MIN_PER_THREAD 65536
+
+int hist_init(hist_t *h, int bins, double lo, double hi, hist_policy_t policy) {
+    memset(h, 0, sizeof *h);
+    if (bins < 1 || !(lo < hi)) {
+        return -1;
+    }
+    h->counts = calloc((size_t)bins, sizeof(uint64_t));
+    if (h->counts == NULL) {
+        return -1;
+    }
+    h->bins = bins;
+    h->lo = lo;
+    h->hi = hi;
+    h->scale = bins / (hi - lo);
+    h->policy = policy;
+    return 0;
+}
+
+void hist_free(hist_t *h) {
+    free(h->counts);
+    h->counts = NULL;
+}
+
+// Count one sample, keeping the out-of-range tallies in locals
+#define HIST_COUNT(h, x, below, above)          \
+    do {                                        \
+        int b_ = hist_bin(h, x);                \
+        if (b_ >= 0) {                          \
+            (h)->counts[b_]++;                  \
+        }                                       \
+        if (!((x) >= (h)->lo)) {                \
+            below++;                            \
+        } else if ((x) > (h)->hi) {             \
+            above++;                            \
+        }                                       \
+    } while (0)
+
+void hist_add_batch(hist_t *h, const double *x, size_t n) {
+    uint64_t below = 0, above = 0;
+    for (size_t i = 0; i < n; i++) {
+        HIST_COUNT(h, x[i], below, above);
+    }
+    h->below += below;
+    h->above += above;
+}
+
+void hist_add_batch_int(hist_t *h, const int32_t *x, size_t n) {
+    uint64_t below = 0, above = 0;
+    for (size_t i = 0; i < n; i++) {
+        double v = x[i];
+        HIST_COUNT(h, v, below, above);
+    }
+    h->below += below;
+    h->above += above;
+}
+
+void hist_merge(hist_t *into, const hist_t *from) {
+    for (int i = 0; i < into->bins; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->below += from->below;
+    into->above += from->above;
+}
+
+typedef struct {
+    hist_t local; // Same bins as the target, counts in a private line-aligned block
+    const void *data;
+    ds_elem_t type;
+    uint64_t begin, end;
+} hist_part_t;
+
+static void *hist_worker(void *arg) {
+    hist_part_t *p = arg;
+    size_t n = (size_t)(p->end - p->begin);
+    if (p->type == DS_INT32) {
+        hist_add_batch_int(&p->local, (const int32_t *)p->data + p->begin, n);
+    } else {
+        hist_add_batch(&p->local, (const double *)p->data + p->begin, n);
+    }
+    return NULL;
+}
+
+int hist_add_parallel(hist_t *h, const void *data, ds_elem_t type, uint64_t n, int threads) {
+    uint64_t most = n / HIST_MIN_PER_THREAD;
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((uint64_t)threads > most) {
+        threads = most > 1 ? (int)most : 1;
+    }
+    if (threads == 1) {
+        if (type == DS_INT32) {
+            hist_add_batch_int(h, data, (size_t)n);
+        } else {
+            hist_add_batch(h, data, (size_t)n);
+        }
+        return 0;
+    }
+
+    // One counter block per thread, each rounded up to whole cache lines
+    size_t stride = ((size_t)h->bins * sizeof(uint64_t) + HIST_LINE - 1) / HIST_LINE * HIST_LINE;
+    uint64_t *counters = aligned_alloc(HIST_LINE, stride * (size_t)threads);
+    hist_part_t *parts = malloc((size_t)threads * sizeof(hist_part_t));
+    pthread_t *tids = malloc((size_t)threads * sizeof(pthread_t));
+    if (counters == NULL || parts == NULL || tids == NULL) {
+        free(counters);
+        free(parts);
+        free(tids);
+        return -1;
+    }
+    memset(counters, 0, stride * (size_t)threads);
+
+    for (int t = 0; t < threads; t++) {
+        hist_part_t *p = &parts[t];
+        p->local = *h;
+        p->local.counts = (uint64_t *)((char *)counters + stride * (size_t)t);
+        p->local.below = 0;
+        p->local.above = 0;
+        p->data = data;
+        p->type = type;
+        p->begin = n * (uint64_t)t / (uint64_t)threads;
+        p->end = n * (uint64_t)(t + 1) / (uint64_t)threads;
+    }
+    // The calling thread takes the first part itself
+    int started = 1;
+    for (int t = 1; t < threads; t++, started++) {
+        if (pthread_create(&tids[t], NULL, hist_worker, &parts[t]) != 0) {
+            break;
+        }
+    }
+    hist_worker(&parts[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    // Parts whose thread could not be started are counted here
+    for (int t = started; t < threads; t++) {
+        hist_worker(&parts[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        hist_merge(h, &parts[t].local);
+    }
+
+    free(counters);
+    free(parts);
+    free(tids);
+    return 0;
+}
+
+void hist_data_range(const void *data, ds_elem_t type, uint64_t n, double *lo, double *hi) {
+    double mn = 0, mx = 0;
+    if (n > 0) {
+        if (type == DS_INT32) {
+            const int32_t *x = data;
+            int32_t a = x[0], b = x[0];
+            for (uint64_t i = 1; i < n; i++) {
+                a = x[i] < a ? x[i] : a;
+                b = x[i] > b ? x[i] : b;
+            }
+            mn = a;
+            mx = b;
+        } else {
+            const double *x = data;
+            mn = mx = x[0];
+            for (uint64_t i = 1; i < n; i++) {
+                mn = x[i] < mn ? x[i] : mn;
+                mx = x[i] > mx ? x[i] : mx;
+            }
+        }
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+void hist_write(const hist_t *h, text_writer_t *w) {
+    for (int i = 0; i < h->bins; i++) {
+        writer_put_str(w, "Bin [");
+        writer_put_int(w, i);
+        writer_put_str(w, "] ----> Count: ");
+        writer_put_int(w, (long long)h->counts[i]);
+        writer_put_char(w, '\n');
+    }
+}
+
+int hist_policy_from_name(const char *name) {
+    if (strcmp(name, "drop") == 0) {
+        return HIST_DROP;
+    }
+    if (strcmp(name, "clamp") == 0) {
+        return HIST_CLAMP;
+    }
+    return -1;
+}
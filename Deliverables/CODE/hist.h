@@ -0,0 +1,71 @@
+/******************************************************************************
+ * File: hist.h
+ *
+ * Purpose:
+ * Fixed-width histograms over a range [lo, hi] with 64-bit counts. Samples
+ * outside the range are either dropped or clamped into the edge bins; the
+ * upper edge hi itself belongs to the last bin.
+ *
+ * hist_add_parallel splits a block of samples between threads. Each thread
+ * counts into its own private, cache-line aligned copy of the bins, and the
+ * copies are summed once at the end, so no counter is ever shared.
+ *
+ * Output is one "Bin [i] ----> Count: c" line per bin, the format read by
+ * histogramPlot.py.
+ *
+ *****************************************************************************/
+#ifndef HIST_H
+#define HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dataset.h"
+#include "writer.h"
+
+typedef enum {
+    HIST_DROP = 0, // Out-of-range samples are not counted
+    HIST_CLAMP = 1 // Out-of-range samples go to the first/last bin
+} hist_policy_t;
+
+typedef struct {
+    int bins;
+    double lo, hi;
+    double scale;     // bins / (hi - lo)
+    hist_policy_t policy;
+    uint64_t *counts; // bins counters
+    uint64_t below;   // Samples under lo (or NaN)
+    uint64_t above;   // Samples over hi
+} hist_t;
+
+// Set up an empty histogram; -1 if bins < 1, lo >= hi or out of memory
+int hist_init(hist_t *h, int bins, double lo, double hi, hist_policy_t policy);
+void hist_free(hist_t *h);
+// Count a block of samples on the calling thread
+void hist_add_batch(hist_t *h, const double *x, size_t n);
+void hist_add_batch_int(hist_t *h, const int32_t *x, size_t n);
+// Count n samples of the given element type using up to threads threads
+int hist_add_parallel(hist_t *h, const void *data, ds_elem_t type, uint64_t n, int threads);
+// Add the counts of from (same bins and range) into into
+void hist_merge(hist_t *into, const hist_t *from);
+// Smallest and largest sample of a block (for a data-driven range)
+void hist_data_range(const void *data, ds_elem_t type, uint64_t n, double *lo, double *hi);
+// Write the "Bin [i] ----> Count: c" lines
+void hist_write(const hist_t *h, text_writer_t *w);
+// Parse "drop" or "clamp"; returns -1 if unknown
+int hist_policy_from_name(const char *name);
+
+// Bin of x, or -1 if x is dropped
+static inline int hist_bin(const hist_t *h, double x) {
+    double t = (x - h->lo) * h->scale;
+    if (!(t >= 0)) {
+        return h->policy == HIST_CLAMP ? 0 : -1;
+    }
+    if (t >= h->bins) {
+        // x == hi lands here by definition, and so can rounding just under it
+        return x <= h->hi || h->policy == HIST_CLAMP ? h->bins - 1 : -1;
+    }
+    return (int)t;
+}
+
+#endif
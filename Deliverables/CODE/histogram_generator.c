@@ -1,90 +1,257 @@
 /******************************************************************************
  * File: histogram_generator.c
- * 
+ *
  * Purpose:
- * This program generates a histogram representing the distribution of random 
- * numbers drawn from a normal distribution. It calculates how many numbers 
- * fall into each bin within a specified range and outputs the histogram.
- * 
+ * This program builds the histogram of a generated data file (any of the
+ * DATA/ScenarioN files, in text or .bin form) or of numbers read from
+ * standard input, and outputs it in the format read by histogramPlot.py.
+ *
  * Features:
- * 1. Generates random numbers from a normal distribution using the Box-Muller 
- *    transform.
- * 2. Defines a range of values for the distribution based on the mean (`mu`) 
- *    and standard deviation (`sigma`).
- * 3. Truncates values that fall outside the range to ensure the histogram is 
- *    accurate and meaningful.
- * 4. Divides the range into a fixed number of bins (`N_BINS`) and counts how 
- *    many numbers fall into each bin.
- * 5. Outputs the histogram data as a list of counts, where each count 
- *    corresponds to a bin.
- * 
+ * 1. mmap()s text data files (one number per line) and parses them in
+ *    parallel (textread.h), or maps binary datasets (dataset.h) and bins
+ *    them in place.
+ * 2. The number of bins, the range and what happens to values outside the
+ *    range (drop or clamp) are parameters; by default the range is the
+ *    smallest to the largest value in the data.
+ * 3. Counts in parallel: every thread bins its own part of the data into
+ *    private counters, which are merged at the end (hist.h).
+ * 4. Counts are 64-bit, so files of any size can be binned.
+ *
  * Output:
- * - Prints the histogram data to the console as a series of integers, one per line.
- * 
+ * - One "Bin [i] ----> Count: c" line per bin, to the console or to a file.
+ *   With several inputs, -o names a directory and each input gets
+ *   <name>_histogram.txt there, as in the HISTOGRAM folder.
+ *
  * Usage:
- * - Compile: gcc histogram_generator.c -lm -o histogram
- * - Execute: ./histogram
- * 
+ * - Compile: gcc histogram_generator.c hist.c textread.c stats.c kll.c gof.c dataset.c writer.c genpool.c qmc.c engine.c normal.c truncnorm.c alias.c batch.c instr.c -lm -lpthread -o histogram
+ * - Execute: ./histogram [-b bins] [-r lo,hi] [-p drop|clamp] [-j threads] [-o out] [file ...]
+ *   Files ending in .bin are read as datasets; "-" or no file reads standard input.
+ *
  * Experimentation Instructions:
- * 1. Modify `mu` (mean), `sigma` (standard deviation), and `n` (number of random 
- *    numbers) to experiment with different distributions.
- * 2. Change the `min` and `max` values to adjust the truncation range.
- * 3. Adjust `N_BINS` to increase or decrease the granularity of the histogram.
- * 
+ * 1. Change -b to increase or decrease the granularity of the histogram.
+ * 2. Use -r to fix the range, e.g. mu - 4 sigma to mu + 4 sigma, and -p to
+ *    choose whether values outside it are dropped or counted in the edge bins.
+ *
  *****************************************************************************/
 
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+#include <unistd.h>
 
-// Macros for generating random numbers
-#define frand() (rand() / (double)RAND_MAX) // Uniform random number in [0, 1)
-#define nrand() (sqrt(-2 * log(frand())) * cos(2 * M_PI * frand())) // Normal random number
+#include "dataset.h" // .bin datasets and text data files
+#include "genpool.h" // genpool_default_threads()
+#include "hist.h"    // Histogram engine
+#include "instr.h"   // Optional run report (-DRNG_INSTRUMENT)
+#include "textread.h" // Parallel mmap text parser
 
-// Number of bins for the histogram
-#define N_BINS 50 
+// Default number of bins for the histogram
+#define N_BINS 50
 
-int main() {
-    // Variables
-    int i, n = 20000;           // Number of random numbers to generate
-    double temp;                // Temporary variable for each random number
-    double mu = 100, sigma = 10; // Mean and standard deviation for normal distribution
-    int histogram[N_BINS];      // Array to store the counts for each bin
+typedef struct {
+    int bins;
+    int has_range;
+    double lo, hi;
+    hist_policy_t policy;
+    int threads;
+} hist_options_t;
 
-    // Initialize random seed
-    srand(time(NULL));
+// Histogram of one input written to out (NULL for the console); 0 on success
+static int histogram_file(const char *in, const char *out, const hist_options_t *opt);
+// Bin an mmap()ed text file without keeping its values (range given with -r)
+static int histogram_stream(const char *in, const text_map_t *tm, const char *out, const hist_options_t *opt);
+// Write a finished histogram to out (NULL for the console) and report outliers
+static int histogram_output(const char *in, const hist_t *h, const char *out);
+// Output path for in inside directory dir: dir/<name>_histogram.txt
+static void histogram_path(char *dst, size_t size, const char *dir, const char *in);
 
-    // Truncation range: four standard deviations from the mean
-    double min = mu - 4 * sigma; 
-    double max = mu + 4 * sigma;
+int main(int argc, char *argv[]) {
+    INSTR_BEGIN(argc, argv);
+    hist_options_t opt = {N_BINS, 0, 0, 0, HIST_DROP, genpool_default_threads()};
+    const char *out = NULL;
+    int c;
 
-    // Initialize the histogram bins to 0
-    for (i = 0; i < N_BINS; i++) {
-        histogram[i] = 0;
+    while ((c = getopt(argc, argv, "b:r:p:j:o:")) != -1) {
+        switch (c) {
+        case 'b':
+            opt.bins = atoi(optarg);
+            if (opt.bins < 1) {
+                fprintf(stderr, "-b expects a positive number of bins\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            if (sscanf(optarg, "%lf,%lf", &opt.lo, &opt.hi) != 2 || !(opt.lo < opt.hi)) {
+                fprintf(stderr, "-r expects lo,hi with lo < hi\n");
+                return EXIT_FAILURE;
+            }
+            opt.has_range = 1;
+            break;
+        case 'p':
+            if (hist_policy_from_name(optarg) < 0) {
+                fprintf(stderr, "Unknown policy '%s' (use drop or clamp)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            opt.policy = (hist_policy_t)hist_policy_from_name(optarg);
+            break;
+        case 'j':
+            opt.threads = atoi(optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b bins] [-r lo,hi] [-p drop|clamp] [-j threads] [-o out] [file ...]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
     }
 
-    // Generate `n` normally distributed random numbers and populate the histogram
-    for (i = 0; i < n; i++) {
-        temp = nrand() * sigma + mu; // Generate a normal random number
+    int inputs = argc - optind;
+    if (inputs > 1 && out == NULL) {
+        fprintf(stderr, "Several inputs need -o <directory>\n");
+        return EXIT_FAILURE;
+    }
+    int rc = EXIT_SUCCESS;
+    if (inputs <= 1) {
+        rc = histogram_file(inputs == 1 ? argv[optind] : "-", out, &opt) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    for (int i = optind; inputs > 1 && i < argc; i++) {
+        char path[512];
+        histogram_path(path, sizeof(path), out, argv[i]);
+        if (histogram_file(argv[i], path, &opt) != 0) {
+            rc = EXIT_FAILURE;
+        }
+    }
+    INSTR_REPORT();
+    return rc;
+}
 
-        // Skip numbers outside the truncation range
-        if (temp < min || temp > max) {
-            i--; // Retry for this iteration
-            continue;
+static int histogram_file(const char *in, const char *out, const hist_options_t *opt) {
+    dataset_t ds;
+    double *text_vals = NULL;
+    const void *data;
+    ds_elem_t type;
+    uint64_t n;
+    size_t len = strlen(in);
+
+    // Binary datasets are used in place. Text files are mmap()ed and parsed in
+    // parallel: straight into the bins when the range is known, into one
+    // array otherwise. Only standard input goes through the line reader.
+    if (len > 4 && strcmp(in + len - 4, ".bin") == 0) {
+        if (dataset_map(in, &ds) != 0) {
+            return -1;
+        }
+        data = ds.data;
+        type = (ds_elem_t)ds.hdr->elem_type;
+        n = ds.count;
+    } else if (strcmp(in, "-") != 0) {
+        text_map_t tm;
+        if (textread_map(in, &tm) != 0) {
+            return -1;
+        }
+        if (opt->has_range) {
+            int rc = histogram_stream(in, &tm, out, opt);
+            textread_unmap(&tm);
+            return rc;
+        }
+        INSTR_TIME_START(t_parse);
+        long long count = textread_parse(&tm, &text_vals, opt->threads);
+        INSTR_TIME_STOP(t_parse, INSTR_PARSE);
+        textread_unmap(&tm);
+        if (count < 0) {
+            fprintf(stderr, "%s: out of memory\n", in);
+            return -1;
+        }
+        memset(&ds, 0, sizeof ds);
+        data = text_vals;
+        type = DS_FLOAT64;
+        n = (uint64_t)count;
+    } else {
+        INSTR_TIME_START(t_parse);
+        long long count = dataset_read_text(stdin, &text_vals);
+        INSTR_TIME_STOP(t_parse, INSTR_PARSE);
+        if (count < 0) {
+            fprintf(stderr, "%s: out of memory\n", in);
+            return -1;
         }
+        memset(&ds, 0, sizeof ds);
+        data = text_vals;
+        type = DS_FLOAT64;
+        n = (uint64_t)count;
+    }
 
-        // Determine the bin index for the random number
-        int bin_index = (int)floor((temp - min) * N_BINS / (max - min));
+    double lo = opt->lo, hi = opt->hi;
+    if (!opt->has_range) {
+        hist_data_range(data, type, n, &lo, &hi);
+        if (!(lo < hi)) {
+            // Empty or constant data: one unit-wide range around the value
+            lo -= 0.5;
+            hi += 0.5;
+        }
+    }
 
-        // Increment the count for the corresponding bin
-        histogram[bin_index]++;
+    hist_t h;
+    int rc = -1;
+    INSTR_TIME_START(t_bin);
+    if (hist_init(&h, opt->bins, lo, hi, opt->policy) != 0) {
+        fprintf(stderr, "%s: cannot set up %d bins on [%g, %g]\n", in, opt->bins, lo, hi);
+    } else if (hist_add_parallel(&h, data, type, n, opt->threads) != 0) {
+        fprintf(stderr, "%s: out of memory\n", in);
+    } else {
+        INSTR_TIME_STOP(t_bin, INSTR_BIN);
+        rc = histogram_output(in, &h, out);
     }
+    hist_free(&h);
+    free(text_vals);
+    dataset_unmap(&ds);
+    return rc;
+}
 
-    // Print the histogram data
-    for (i = 0; i < N_BINS; i++) {
-        printf("Bin:[%d] ----> Bin Count:[%d]\n", i, histogram[i]); // Print the count for each bin
+static int histogram_stream(const char *in, const text_map_t *tm, const char *out, const hist_options_t *opt) {
+    hist_t h;
+    int rc = -1;
+    if (hist_init(&h, opt->bins, opt->lo, opt->hi, opt->policy) != 0) {
+        fprintf(stderr, "%s: cannot set up %d bins on [%g, %g]\n", in, opt->bins, opt->lo, opt->hi);
+    } else {
+        // Parsing and binning happen in one pass here: it all counts as parsing
+        INSTR_TIME_START(t_parse);
+        long long count = textread_scan(tm, opt->threads, NULL, &h);
+        INSTR_TIME_STOP(t_parse, INSTR_PARSE);
+        if (count < 0) {
+            fprintf(stderr, "%s: out of memory\n", in);
+        } else {
+            rc = histogram_output(in, &h, out);
+        }
     }
+    hist_free(&h);
+    return rc;
+}
 
+static int histogram_output(const char *in, const hist_t *h, const char *out) {
+    text_writer_t w;
+    if ((out != NULL ? writer_open(&w, out) : writer_attach(&w, STDOUT_FILENO)) != 0) {
+        perror(out);
+        return -1;
+    }
+    hist_write(h, &w);
+    if (writer_close(&w) != 0) {
+        perror(out != NULL ? out : "stdout");
+        return -1;
+    }
+    if (h->below + h->above > 0) {
+        fprintf(stderr, "%s: %llu values below and %llu above [%g, %g] were %s\n", in,
+                (unsigned long long)h->below, (unsigned long long)h->above, h->lo, h->hi,
+                h->policy == HIST_CLAMP ? "clamped into the edge bins" : "dropped");
+    }
     return 0;
 }
+
+static void histogram_path(char *dst, size_t size, const char *dir, const char *in) {
+    const char *base = strrchr(in, '/');
+    base = base != NULL ? base + 1 : in;
+    const char *dot = strrchr(base, '.');
+    int stem = dot != NULL ? (int)(dot - base) : (int)strlen(base);
+    snprintf(dst, size, "%s/%.*s_histogram.txt", dir, stem, base);
+}
@@ -0,0 +1,183 @@
+/******************************************************************************
+ * File: instr.c
+ *
+ * Purpose:
+ * Per-thread counter registration and the JSON run report for instr.h.
+ * Empty unless built with -DRNG_INSTRUMENT.
+ *
+ *****************************************************************************/
+#include "instr.h"
+
+#ifdef RNG_INSTRUMENT
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+__thread instr_thread_t *instr_self;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static instr_thread_t *registry;
+// Used when a thread's counters cannot be allocated: shared, so only approximate
+static instr_thread_t fallback;
+static char program[64] = "rng";
+static char command[1024];
+static uint64_t started;
+
+static const char *STAGE_NAMES[INSTR_STAGES] = {"generate", "summarise", "format", "commit_wait",
+                                                "writer_stall", "write", "parse", "bin", "checkpoint"};
+
+instr_thread_t *instr_register(void) {
+    instr_thread_t *t = calloc(1, sizeof *t);
+    if (t == NULL) {
+        return instr_self = &fallback;
+    }
+    pthread_mutex_lock(&registry_lock);
+    t->next = registry;
+    registry = t;
+    pthread_mutex_unlock(&registry_lock);
+    return instr_self = t;
+}
+
+uint64_t instr_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void instr_begin(int argc, char **argv) {
+    const char *base = strrchr(argv[0], '/');
+    snprintf(program, sizeof(program), "%s", base != NULL ? base + 1 : argv[0]);
+    size_t len = 0;
+    for (int i = 0; i < argc && len < sizeof(command); i++) {
+        len += (size_t)snprintf(command + len, sizeof(command) - len, "%s%s", i > 0 ? " " : "", argv[i]);
+    }
+    started = instr_now();
+}
+
+void instr_latency(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int b = 0;
+    while (b < INSTR_LATENCY_BUCKETS - 1 && us >= ((uint64_t)1 << b)) {
+        b++;
+    }
+    instr_thread()->latency[b]++;
+}
+
+// JSON string body: quotes, backslashes and control characters escaped
+static void put_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(out, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned)*s);
+        } else {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// "name": {"proposals": p, "rejected": r, "acceptance": a}
+static void put_rejection(FILE *out, const char *name, uint64_t proposals, uint64_t rejected, int last) {
+    fprintf(out, "    \"%s\": {\"proposals\": %llu, \"rejected\": %llu, \"acceptance\": ", name,
+            (unsigned long long)proposals, (unsigned long long)rejected);
+    if (proposals > 0) {
+        fprintf(out, "%.6f}", 1 - (double)rejected / (double)proposals);
+    } else {
+        fprintf(out, "null}");
+    }
+    fprintf(out, "%s\n", last ? "" : ",");
+}
+
+int instr_report(void) {
+    // Sum every thread (the workers have been joined by now)
+    instr_thread_t sum;
+    memset(&sum, 0, sizeof sum);
+    pthread_mutex_lock(&registry_lock);
+    for (instr_thread_t *t = registry;; t = t->next) {
+        const instr_thread_t *src = t != NULL ? t : &fallback;
+        for (int k = 0; k < INSTR_COUNTERS; k++) {
+            sum.counters[k] += src->counters[k];
+        }
+        for (int s = 0; s < INSTR_STAGES; s++) {
+            sum.stage_ns[s] += src->stage_ns[s];
+            sum.stage_calls[s] += src->stage_calls[s];
+        }
+        for (int b = 0; b < INSTR_LATENCY_BUCKETS; b++) {
+            sum.latency[b] += src->latency[b];
+        }
+        if (t == NULL) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    const char *path = getenv("RNG_INSTRUMENT_REPORT");
+    char name[96];
+    if (path == NULL || *path == '\0') {
+        snprintf(name, sizeof(name), "%s_report.json", program);
+        path = name;
+    }
+    FILE *out = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    const uint64_t *c = sum.counters;
+    fprintf(out, "{\n  \"program\": ");
+    put_json_string(out, program);
+    fprintf(out, ",\n  \"command\": ");
+    put_json_string(out, command);
+    fprintf(out, ",\n  \"wall_seconds\": %.6f,\n", (double)(instr_now() - started) * 1e-9);
+    fprintf(out, "  \"peak_rss_kib\": %ld,\n", ru.ru_maxrss);
+
+    // Stage times are summed over threads, so they can exceed the wall time
+    fprintf(out, "  \"stages\": {\n");
+    for (int s = 0; s < INSTR_STAGES; s++) {
+        fprintf(out, "    \"%s\": {\"seconds\": %.6f, \"calls\": %llu}%s\n", STAGE_NAMES[s],
+                (double)sum.stage_ns[s] * 1e-9, (unsigned long long)sum.stage_calls[s],
+                s + 1 < INSTR_STAGES ? "," : "");
+    }
+    fprintf(out, "  },\n  \"samples\": {\n");
+    for (int t = 1; t <= DIST_COUNT; t++) {
+        fprintf(out, "    \"%s\": %llu%s\n", dist_file_name(t), (unsigned long long)c[INSTR_SAMPLES + t],
+                t < DIST_COUNT ? "," : "");
+    }
+    fprintf(out, "  },\n  \"rejection\": {\n");
+    put_rejection(out, "truncated_normal_rejection", c[INSTR_TRUNC_PROPOSALS], c[INSTR_TRUNC_REJECTED], 0);
+    put_rejection(out, "truncated_normal_tail", c[INSTR_TAIL_PROPOSALS], c[INSTR_TAIL_REJECTED], 0);
+    put_rejection(out, "ziggurat_slow_path", c[INSTR_ZIGGURAT_SLOW], c[INSTR_ZIGGURAT_REJECTED], 0);
+    put_rejection(out, "bounded_integer", c[INSTR_BOUNDED_DRAWS], c[INSTR_BOUNDED_REJECTED], 1);
+    fprintf(out, "  },\n  \"bytes_written\": %llu,\n", (unsigned long long)c[INSTR_BYTES_WRITTEN]);
+
+    // Trailing empty buckets are left out
+    int top = INSTR_LATENCY_BUCKETS;
+    while (top > 0 && sum.latency[top - 1] == 0) {
+        top--;
+    }
+    uint64_t flushes = 0;
+    fprintf(out, "  \"flush_latency_us\": {\"buckets\": [");
+    for (int b = 0; b < top; b++) {
+        flushes += sum.latency[b];
+        fprintf(out, "%s{\"lt\": %llu, \"count\": %llu}", b > 0 ? ", " : "", 1ULL << b,
+                (unsigned long long)sum.latency[b]);
+    }
+    fprintf(out, "], \"count\": %llu}\n}\n", (unsigned long long)flushes);
+
+    int rc = ferror(out) ? -1 : 0;
+    if (out != stderr) {
+        rc |= fclose(out) != 0 ? -1 : 0;
+        fprintf(stderr, "Instrumentation report: %s\n", path);
+    }
+    return rc;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * File: instr.h
+ *
+ * Purpose:
+ * Optional instrumentation of the generation hot paths, for finding out
+ * where the time of an rns / rng / histogram run goes and which parameter
+ * sets make the rejection samplers work hard. It records:
+ *
+ * - Per-stage wall time and call counts (generate, summarise, format,
+ *   waiting for the commit turn, waiting for a free writer buffer, the
+ *   write() calls themselves, text parsing and binning).
+ * - Samples per distribution type.
+ * - Proposals and rejections of every rejection loop (truncated-normal
+ *   rejection and tail samplers, the ziggurat slow path, the bounded
+ *   integer multiply-shift), hence their acceptance rates.
+ * - Bytes written and a log2 histogram of buffer flush latencies.
+ * - Peak RSS (getrusage).
+ *
+ * Build with -DRNG_INSTRUMENT (make INSTRUMENT=1). Without it every INSTR_*
+ * macro expands to nothing and the code is exactly the uninstrumented one.
+ * With it, counters are per thread (no atomics, no shared cache lines) and
+ * are bumped once per block wherever the loop allows, so the overhead stays
+ * in the noise.
+ *
+ * INSTR_REPORT() at the end of main writes a JSON report to the file named
+ * by RNG_INSTRUMENT_REPORT ("-" for stderr), default <program>_report.json.
+ *
+ *****************************************************************************/
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stdint.h>
+
+#include "dist.h"
+
+typedef enum {
+    INSTR_GENERATE = 0,  // Sampling into a block
+    INSTR_SUMMARISE,     // Stats / histogram / sketch / goodness-of-fit of a block
+    INSTR_FORMAT,        // Text and binary formatting of a block
+    INSTR_COMMIT_WAIT,   // Waiting for the previous chunk of the file to commit
+    INSTR_WRITER_STALL,  // Producer waiting for a free asynchronous buffer
+    INSTR_WRITE,         // write() / io_uring calls
+    INSTR_PARSE,         // Text data files parsed back into numbers (and binned, when streamed)
+    INSTR_BIN,           // Histogram binning of values already in memory
+    INSTR_CHECKPOINT,    // Syncing outputs to disk and writing checkpoint records
+    INSTR_STAGES
+} instr_stage_t;
+
+typedef enum {
+    INSTR_SAMPLES = 0,                              // + dist_type_t: samples of that type
+    INSTR_TRUNC_PROPOSALS = INSTR_SAMPLES + DIST_COUNT + 1, // Truncated normal, rejection strategy
+    INSTR_TRUNC_REJECTED,
+    INSTR_TAIL_PROPOSALS,                           // Truncated normal, exponential tail strategy
+    INSTR_TAIL_REJECTED,
+    INSTR_ZIGGURAT_SLOW,                            // Ziggurat wedge / tail tries off the fast path ...
+    INSTR_ZIGGURAT_REJECTED,                        // ... and how many of them were rejected
+    INSTR_BOUNDED_DRAWS,                            // Bounded integer multiply-shift
+    INSTR_BOUNDED_REJECTED,
+    INSTR_BYTES_WRITTEN,
+    INSTR_COUNTERS
+} instr_counter_t;
+
+// Flush latency buckets: bucket b counts flushes of < 2^b microseconds
+#define INSTR_LATENCY_BUCKETS 32
+
+#ifdef RNG_INSTRUMENT
+
+// One thread's counters; registered on first use and kept until exit
+typedef struct instr_thread {
+    uint64_t counters[INSTR_COUNTERS];
+    uint64_t stage_ns[INSTR_STAGES];
+    uint64_t stage_calls[INSTR_STAGES];
+    uint64_t latency[INSTR_LATENCY_BUCKETS];
+    struct instr_thread *next;
+} instr_thread_t;
+
+extern __thread instr_thread_t *instr_self;
+
+instr_thread_t *instr_register(void);
+// Monotonic clock in nanoseconds
+uint64_t instr_now(void);
+// Record the program name and command line, and start the run clock
+void instr_begin(int argc, char **argv);
+// Write the JSON report; 0 on success
+int instr_report(void);
+// Count one flush of the given duration
+void instr_latency(uint64_t ns);
+
+static inline instr_thread_t *instr_thread(void) {
+    return instr_self != NULL ? instr_self : instr_register();
+}
+
+static inline void instr_add(instr_counter_t k, uint64_t n) {
+    instr_thread()->counters[k] += n;
+}
+
+static inline void instr_stage(instr_stage_t s, uint64_t ns) {
+    instr_thread_t *t = instr_thread();
+    t->stage_ns[s] += ns;
+    t->stage_calls[s]++;
+}
+
+#define INSTR_BEGIN(argc, argv) instr_begin(argc, argv)
+#define INSTR_REPORT() instr_report()
+#define INSTR_ADD(k, n) instr_add(k, (uint64_t)(n))
+// Local tally for loops that count per draw: bumped in the loop, added once after it
+#define INSTR_LOCAL(v) uint64_t v = 0
+#define INSTR_INC(v) ((v)++)
+#define INSTR_TIME_START(v) uint64_t v = instr_now()
+#define INSTR_TIME_STOP(v, stage) instr_stage(stage, instr_now() - (v))
+#define INSTR_LATENCY(ns) instr_latency(ns)
+
+#else
+
+#define INSTR_BEGIN(argc, argv) ((void)0)
+#define INSTR_REPORT() ((void)0)
+#define INSTR_ADD(k, n) ((void)0)
+#define INSTR_LOCAL(v)
+#define INSTR_INC(v) ((void)0)
+#define INSTR_TIME_START(v)
+#define INSTR_TIME_STOP(v, stage) ((void)0)
+#define INSTR_LATENCY(ns) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,373 @@
+/******************************************************************************
+ * File: kll.c
+ *
+ * Purpose:
+ * Compaction, merging and queries of the KLL sketch in kll.h. Levels follow
+ * the lazy scheme of the original paper: level h may hold
+ * max(2, k (2/3)^(depth)) items, where depth counts levels down from the
+ * top, and a compaction only happens once the whole sketch is full.
+ *
+ * Levels above 0 are kept sorted: a compaction promotes a sorted run, which
+ * is merged into the next level in linear time, so only level 0 (the fresh
+ * samples) is ever sorted.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kll.h"
+
+// Seed of the compaction coin (any fixed value)
+#define KLL_COIN_SEED 0x9e3779b97f4a7c15ULL
+// Smallest capacity of a level (the paper's m): bounds how often the bottom compacts
+#define KLL_MIN_WIDTH 8
+// Capacity of level 0, unless k is larger
+#define KLL_LEVEL0 2048
+// Shortest run worth radix sorting
+#define KLL_RADIX_MIN 256
+
+typedef struct {
+    double value;
+    uint64_t weight;
+} kll_item_t;
+
+static int coin_flip(kll_t *s) {
+    // splitmix64 step; one bit per compaction
+    uint64_t z = (s->coin += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (int)((z ^ (z >> 31)) & 1);
+}
+
+// In-place ascending sort: quicksort with insertion sort for short runs
+static void sort_doubles(double *a, size_t n) {
+    while (n > 16) {
+        double x = a[0], y = a[n / 2], z = a[n - 1];
+        double pivot = x < y ? (y < z ? y : (x < z ? z : x)) : (x < z ? x : (y < z ? z : y));
+        size_t i = 0, j = n - 1;
+        for (;;) {
+            while (a[i] < pivot) {
+                i++;
+            }
+            while (a[j] > pivot) {
+                j--;
+            }
+            if (i >= j) {
+                break;
+            }
+            double t = a[i];
+            a[i++] = a[j];
+            a[j--] = t;
+        }
+        // Recurse into the smaller side, loop on the larger
+        if (j + 1 < n - j - 1) {
+            sort_doubles(a, j + 1);
+            a += j + 1;
+            n -= j + 1;
+        } else {
+            sort_doubles(a + j + 1, n - j - 1);
+            n = j + 1;
+        }
+    }
+    for (size_t i = 1; i < n; i++) {
+        double v = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > v) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+// Order-preserving map of a double onto an unsigned key (and back)
+static inline uint64_t double_key(double x) {
+    uint64_t u;
+    memcpy(&u, &x, sizeof u);
+    return u >> 63 ? ~u : u | 0x8000000000000000ULL;
+}
+
+static inline double key_double(uint64_t u) {
+    u = u >> 63 ? u & 0x7fffffffffffffffULL : ~u;
+    double x;
+    memcpy(&x, &u, sizeof x);
+    return x;
+}
+
+// LSD radix sort, one byte per pass; passes where every key shares the byte
+// are skipped. Falls back to sort_doubles for short or unallocatable input.
+static void radix_sort_doubles(double *a, size_t n) {
+    uint64_t *keys = n >= KLL_RADIX_MIN ? malloc(2 * n * sizeof(uint64_t)) : NULL;
+    if (keys == NULL) {
+        sort_doubles(a, n);
+        return;
+    }
+    uint64_t *src = keys, *dst = keys + n;
+    static const int passes = 8;
+    size_t counts[8][256] = {{0}};
+    for (size_t i = 0; i < n; i++) {
+        uint64_t k = double_key(a[i]);
+        src[i] = k;
+        for (int p = 0; p < passes; p++) {
+            counts[p][(k >> (8 * p)) & 0xff]++;
+        }
+    }
+    for (int p = 0; p < passes; p++) {
+        size_t *c = counts[p];
+        if (c[(src[0] >> (8 * p)) & 0xff] == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t t = c[b];
+            c[b] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[c[(src[i] >> (8 * p)) & 0xff]++] = src[i];
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    for (size_t i = 0; i < n; i++) {
+        a[i] = key_double(src[i]);
+    }
+    free(keys);
+}
+
+// Recompute the per-level thresholds after the number of levels changed
+static void set_capacities(kll_t *s) {
+    double c = s->k;
+    s->total_capacity = 0;
+    for (int h = s->levels - 1; h >= 0; h--) {
+        uint32_t cap = (uint32_t)ceil(c);
+        s->capacity[h] = cap > KLL_MIN_WIDTH ? cap : KLL_MIN_WIDTH;
+        s->total_capacity += s->capacity[h];
+        c *= 2.0 / 3;
+    }
+    // Level 0 is wider: fresh samples are radix sorted KLL_LEVEL0 at a time,
+    // which costs a few KiB more but makes compactions far fewer and cheaper
+    uint32_t wide = s->k > KLL_LEVEL0 ? (uint32_t)s->k : KLL_LEVEL0;
+    s->total_capacity += wide - s->capacity[0];
+    s->capacity[0] = wide;
+}
+
+// Make room for n more items at level h; -1 if out of memory
+static int level_reserve(kll_t *s, int h, uint32_t n) {
+    if (s->size[h] + n <= s->alloc[h]) {
+        return 0;
+    }
+    uint32_t len = s->alloc[h] ? s->alloc[h] : 16;
+    while (len < s->size[h] + n) {
+        len *= 2;
+    }
+    double *grown = realloc(s->items[h], len * sizeof(double));
+    if (grown == NULL) {
+        return -1;
+    }
+    s->items[h] = grown;
+    s->alloc[h] = len;
+    return 0;
+}
+
+// Merge the sorted run src[0..n) into sorted level h (h >= 1); -1 if out of memory
+static int level_merge_run(kll_t *s, int h, const double *src, uint32_t n) {
+    if (level_reserve(s, h, n) != 0) {
+        return -1;
+    }
+    // From the back, so the level can be merged in place
+    double *a = s->items[h];
+    uint32_t i = s->size[h], j = n, k = s->size[h] + n;
+    while (j > 0) {
+        a[--k] = i > 0 && a[i - 1] > src[j - 1] ? a[--i] : src[--j];
+    }
+    s->size[h] += n;
+    return 0;
+}
+
+// Promote half of level h to level h + 1
+static int compact_level(kll_t *s, int h) {
+    if (h + 1 == s->levels) {
+        if (s->levels == KLL_MAX_LEVELS) {
+            return -1;
+        }
+        s->levels++;
+        set_capacities(s);
+    }
+    uint32_t m = s->size[h];
+    double *a = s->items[h];
+    if (h == 0) {
+        radix_sort_doubles(a, m);
+    }
+    // An odd item out stays behind (the smallest) so weights stay exact;
+    // the survivors are packed to the front of the level, still sorted
+    uint32_t first = m & 1;
+    uint32_t promoted = (m - first) / 2;
+    int offset = coin_flip(s);
+    for (uint32_t i = 0; i < promoted; i++) {
+        a[first + i] = a[first + (uint32_t)offset + 2 * i];
+    }
+    if (level_merge_run(s, h + 1, a + first, promoted) != 0) {
+        return -1;
+    }
+    s->size[h] = first;
+    s->total -= m - first - promoted;
+    return 0;
+}
+
+// Compact until the sketch is within its capacity
+static int compress(kll_t *s) {
+    while (s->total >= s->total_capacity) {
+        int h = 0;
+        while (h < s->levels && s->size[h] < s->capacity[h]) {
+            h++;
+        }
+        if (h == s->levels || compact_level(s, h) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int kll_init(kll_t *s, int k) {
+    if (k < 8) {
+        return -1;
+    }
+    memset(s, 0, sizeof *s);
+    s->k = k;
+    s->levels = 1;
+    s->coin = KLL_COIN_SEED;
+    set_capacities(s);
+    return 0;
+}
+
+void kll_free(kll_t *s) {
+    for (int h = 0; h < KLL_MAX_LEVELS; h++) {
+        free(s->items[h]);
+        s->items[h] = NULL;
+    }
+    s->levels = 0;
+    s->total = 0;
+    s->n = 0;
+}
+
+void kll_push_batch(kll_t *s, const double *x, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        if (s->total >= s->total_capacity && compress(s) != 0) {
+            return;
+        }
+        // Fill level 0 up to the point where the sketch is full
+        uint32_t room = (uint32_t)(s->total_capacity - s->total);
+        if (level_reserve(s, 0, room) != 0) {
+            return;
+        }
+        double *dst = s->items[0] + s->size[0];
+        uint32_t taken = 0;
+        for (; i < n && taken < room; i++) {
+            if (x[i] == x[i]) {
+                dst[taken++] = x[i];
+            }
+        }
+        s->size[0] += taken;
+        s->total += taken;
+        s->n += taken;
+    }
+}
+
+int kll_merge(kll_t *into, const kll_t *from) {
+    if (from->n == 0) {
+        return 0;
+    }
+    if (from->levels > into->levels) {
+        into->levels = from->levels;
+        set_capacities(into);
+    }
+    for (int h = 0; h < from->levels; h++) {
+        if (from->size[h] == 0) {
+            continue;
+        }
+        if (h == 0) {
+            if (level_reserve(into, 0, from->size[0]) != 0) {
+                return -1;
+            }
+            memcpy(into->items[0] + into->size[0], from->items[0], from->size[0] * sizeof(double));
+            into->size[0] += from->size[0];
+        } else if (level_merge_run(into, h, from->items[h], from->size[h]) != 0) {
+            return -1;
+        }
+        into->total += from->size[h];
+    }
+    into->n += from->n;
+    return compress(into);
+}
+
+static int item_cmp(const void *a, const void *b) {
+    double x = ((const kll_item_t *)a)->value, y = ((const kll_item_t *)b)->value;
+    return (x > y) - (x < y);
+}
+
+// All items with their weights, sorted by value; NULL if empty or out of memory
+static kll_item_t *sorted_view(const kll_t *s) {
+    if (s->total == 0) {
+        return NULL;
+    }
+    kll_item_t *v = malloc(s->total * sizeof(kll_item_t));
+    if (v == NULL) {
+        return NULL;
+    }
+    size_t len = 0;
+    for (int h = 0; h < s->levels; h++) {
+        for (uint32_t i = 0; i < s->size[h]; i++) {
+            v[len].value = s->items[h][i];
+            v[len++].weight = (uint64_t)1 << h;
+        }
+    }
+    qsort(v, len, sizeof(kll_item_t), item_cmp);
+    return v;
+}
+
+void kll_quantiles(const kll_t *s, const double *q, double *out, int m) {
+    kll_item_t *v = sorted_view(s);
+    for (int i = 0; i < m; i++) {
+        out[i] = NAN;
+    }
+    if (v == NULL) {
+        return;
+    }
+    for (int i = 0; i < m; i++) {
+        // First item whose cumulative weight reaches q * n
+        double target = q[i] * (double)s->n;
+        uint64_t cum = 0;
+        size_t j = 0;
+        for (; j + 1 < s->total; j++) {
+            cum += v[j].weight;
+            if ((double)cum >= target) {
+                break;
+            }
+        }
+        out[i] = v[j].value;
+    }
+    free(v);
+}
+
+double kll_quantile(const kll_t *s, double q) {
+    double out;
+    kll_quantiles(s, &q, &out, 1);
+    return out;
+}
+
+double kll_cdf(const kll_t *s, double x) {
+    if (s->n == 0) {
+        return NAN;
+    }
+    uint64_t below = 0;
+    for (int h = 0; h < s->levels; h++) {
+        for (uint32_t i = 0; i < s->size[h]; i++) {
+            below += s->items[h][i] <= x ? (uint64_t)1 << h : 0; // Weights add up to n
+        }
+    }
+    return (double)below / (double)s->n;
+}
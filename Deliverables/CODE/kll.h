@@ -0,0 +1,59 @@
+/******************************************************************************
+ * File: kll.h
+ *
+ * Purpose:
+ * KLL quantile sketch (Karnin, Lang and Liberty, 2016) for certifying the
+ * shape of a generated dataset without storing or sorting it. The sketch
+ * keeps a few thousand samples in levels; an item at level h stands for 2^h
+ * samples. When the sketch is full, the lowest over-full level is sorted and
+ * every other item (odd or even positions, by a coin toss) is promoted to
+ * the next level, so memory stays O(k log(n / k)) items, plus an intake
+ * level of 2048 fresh samples that are radix sorted together.
+ *
+ * With k = KLL_K the normalised rank error of any quantile is about 1.7%
+ * (99% confidence); error shrinks like 1/k.
+ *
+ * Sketches merge (level by level, then compact as usual), so every thread
+ * or chunk can keep its own. The coin is a fixed-seed generator, so the same
+ * pushes and merges in the same order always give the same sketch.
+ *
+ *****************************************************************************/
+#ifndef KLL_H
+#define KLL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Default accuracy parameter (capacity of the top level)
+#define KLL_K 200
+// Enough levels for 2^64 samples at any k >= 2
+#define KLL_MAX_LEVELS 64
+
+typedef struct {
+    int k;
+    int levels;                        // Levels in use (at least 1)
+    double *items[KLL_MAX_LEVELS];     // Level h holds size[h] items of weight 2^h
+    uint32_t size[KLL_MAX_LEVELS];
+    uint32_t alloc[KLL_MAX_LEVELS];    // Allocated length of items[h]
+    uint32_t capacity[KLL_MAX_LEVELS]; // Compaction threshold of each level
+    uint64_t total;                    // Items held, over all levels
+    uint64_t total_capacity;
+    uint64_t n;                        // Samples summarised
+    uint64_t coin;                     // State of the compaction coin
+} kll_t;
+
+// Start an empty sketch with accuracy parameter k (>= 8); -1 on bad k
+int kll_init(kll_t *s, int k);
+void kll_free(kll_t *s);
+// Summarise a block of samples (NaNs are ignored)
+void kll_push_batch(kll_t *s, const double *x, size_t n);
+// Add everything summarised by from into into
+int kll_merge(kll_t *into, const kll_t *from);
+// Estimated q-quantile (0 <= q <= 1); NaN if empty
+double kll_quantile(const kll_t *s, double q);
+// Several quantiles at once (one sort); out[i] for q[i]
+void kll_quantiles(const kll_t *s, const double *q, double *out, int m);
+// Estimated fraction of samples <= x
+double kll_cdf(const kll_t *s, double x);
+
+#endif
@@ -0,0 +1,102 @@
+/******************************************************************************
+ * File: normal.c
+ *
+ * Purpose:
+ * Table setup and the slow paths for the normal samplers in normal.h.
+ *
+ * The ziggurat follows Marsaglia & Tsang (2000) in the form given by Doornik
+ * (2005): 128 layers of equal area V with the base strip ending at R.
+ *
+ *****************************************************************************/
+#include <string.h>
+
+#include "instr.h"
+#include "normal.h"
+
+// Right edge of the base layer and the common area of every layer
+#define ZIG_R 3.442619855899
+#define ZIG_V 9.91256303526217e-3
+
+double normal_zig_x[ZIG_LAYERS + 1];
+double normal_zig_r[ZIG_LAYERS];
+
+// Build the layer tables once, before main runs
+__attribute__((constructor)) static void normal_init_tables(void) {
+    double f = exp(-0.5 * ZIG_R * ZIG_R);
+    normal_zig_x[0] = ZIG_V / f; // Base strip is extended to hold the tail area
+    normal_zig_x[1] = ZIG_R;
+    normal_zig_x[ZIG_LAYERS] = 0;
+    for (int i = 2; i < ZIG_LAYERS; i++) {
+        normal_zig_x[i] = sqrt(-2 * log(ZIG_V / normal_zig_x[i - 1] + f));
+        f = exp(-0.5 * normal_zig_x[i] * normal_zig_x[i]);
+    }
+    for (int i = 0; i < ZIG_LAYERS; i++) {
+        normal_zig_r[i] = normal_zig_x[i + 1] / normal_zig_x[i];
+    }
+}
+
+// Sample from the tail beyond R (Marsaglia 1964)
+static double normal_tail(rng_engine_t *eng, int negative) {
+    double x, y;
+    INSTR_LOCAL(tries);
+    do {
+        INSTR_INC(tries);
+        x = log(1.0 - frand(eng)) / ZIG_R;
+        y = log(1.0 - frand(eng));
+    } while (-2 * y < x * x);
+    INSTR_ADD(INSTR_ZIGGURAT_SLOW, tries);
+    INSTR_ADD(INSTR_ZIGGURAT_REJECTED, tries - 1);
+    return negative ? x - ZIG_R : ZIG_R - x;
+}
+
+double normal_ziggurat_slow(rng_engine_t *eng, int layer, double u) {
+    for (;;) {
+        if (layer == 0) {
+            return normal_tail(eng, u < 0);
+        }
+        INSTR_ADD(INSTR_ZIGGURAT_SLOW, 1);
+
+        // Point lies in the wedge between layer edges: accept under the curve
+        double x = u * normal_zig_x[layer];
+        double f0 = exp(-0.5 * (normal_zig_x[layer] * normal_zig_x[layer] - x * x));
+        double f1 = exp(-0.5 * (normal_zig_x[layer + 1] * normal_zig_x[layer + 1] - x * x));
+        if (f1 + frand(eng) * (f0 - f1) < 1.0) {
+            return x;
+        }
+
+        // Rejected: start over with a fresh layer and abscissa
+        INSTR_ADD(INSTR_ZIGGURAT_REJECTED, 1);
+        uint64_t bits = engine_next_u64(eng);
+        layer = (int)(bits & (ZIG_LAYERS - 1));
+        u = 2.0 * engine_bits_to_double(bits) - 1.0;
+        if (fabs(u) < normal_zig_r[layer]) {
+            return u * normal_zig_x[layer];
+        }
+    }
+}
+
+double normal_box_muller(rng_engine_t *eng) {
+    if (eng->has_spare) {
+        eng->has_spare = 0;
+        return eng->spare;
+    }
+    double r = sqrt(-2 * log(1.0 - frand(eng))); // 1 - frand() is in (0, 1]
+    double theta = 2 * 3.141592653589793238 * frand(eng);
+    eng->spare = r * sin(theta);
+    eng->has_spare = 1;
+    return r * cos(theta);
+}
+
+int normal_method_from_name(const char *name) {
+    if (strcmp(name, "ziggurat") == 0) {
+        return NORMAL_ZIGGURAT;
+    }
+    if (strcmp(name, "boxmuller") == 0 || strcmp(name, "box-muller") == 0) {
+        return NORMAL_BOX_MULLER;
+    }
+    return -1;
+}
+
+const char *normal_method_name(normal_method_t method) {
+    return method == NORMAL_BOX_MULLER ? "box-muller" : "ziggurat";
+}
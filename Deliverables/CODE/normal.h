@@ -0,0 +1,71 @@
+/******************************************************************************
+ * File: normal.h
+ *
+ * Purpose:
+ * Standard normal samplers on top of the engine layer.
+ *
+ * Methods:
+ * 1. **Ziggurat** (default): 128-layer Marsaglia-Tsang ziggurat with
+ *    precomputed tables. About 99% of draws cost one 64-bit word, a table
+ *    lookup and a multiply; only the rare wedge/tail cases call exp/log.
+ * 2. **Box-Muller**: kept for comparison. Both variates of each pair are used,
+ *    the second one is cached in the engine for the next call.
+ *
+ * The method is chosen per engine: eng->normal_method = NORMAL_BOX_MULLER.
+ *
+ *****************************************************************************/
+#ifndef NORMAL_H
+#define NORMAL_H
+
+#include <math.h>
+
+#include "engine.h"
+
+typedef enum {
+    NORMAL_ZIGGURAT = 0,
+    NORMAL_BOX_MULLER = 1
+} normal_method_t;
+
+#define ZIG_LAYERS 128
+
+// Layer edges x[0..128] and the ratios x[i+1] / x[i] (filled at startup)
+extern double normal_zig_x[ZIG_LAYERS + 1];
+extern double normal_zig_r[ZIG_LAYERS];
+
+// Wedge and tail handling for the ziggurat (rare path)
+double normal_ziggurat_slow(rng_engine_t *eng, int layer, double u);
+// Box-Muller transform, returning the cached sine variate every other call
+double normal_box_muller(rng_engine_t *eng);
+// Parse a method name ("ziggurat" or "boxmuller"); returns -1 if unknown
+int normal_method_from_name(const char *name);
+// Human readable method name
+const char *normal_method_name(normal_method_t method);
+
+// Ziggurat variate from the word bits just drawn from eng (eng is only
+// drawn from again on the rare slow path); lets a loop inline its engine
+static inline double normal_ziggurat_bits(rng_engine_t *eng, uint64_t bits) {
+    int layer = (int)(bits & (ZIG_LAYERS - 1)); // Low bits pick the layer
+    double u = 2.0 * engine_bits_to_double(bits) - 1.0; // High 52 bits: u in [-1, 1)
+    if (fabs(u) < normal_zig_r[layer]) {
+        return u * normal_zig_x[layer];
+    }
+    return normal_ziggurat_slow(eng, layer, u);
+}
+
+// Standard normal variate using the ziggurat method
+static inline double normal_ziggurat(rng_engine_t *eng) {
+    return normal_ziggurat_bits(eng, engine_next_u64(eng));
+}
+
+// Standard normal variate using the engine's selected method
+static inline double normal_draw(rng_engine_t *eng) {
+    if (eng->normal_method == NORMAL_BOX_MULLER) {
+        return normal_box_muller(eng);
+    }
+    return normal_ziggurat(eng);
+}
+
+// Macro for generating random real numbers from a standard normal distribution
+#define nrand(eng) normal_draw(eng)
+
+#endif
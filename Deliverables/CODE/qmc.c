@@ -0,0 +1,303 @@
+/******************************************************************************
+ * File: qmc.c
+ *
+ * Purpose:
+ * Sobol and Halton points, their scrambling, and the inverse-CDF mapping to
+ * the distributions of batch_dist_t, for qmc.h.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#include "engine.h"
+#include "instr.h"
+#include "qmc.h"
+#include "truncnorm.h"
+
+// Points mapped per step of qmc_dist_fill
+#define QMC_BLOCK 512
+
+static const char *QMC_NAMES[] = {"prng", "sobol", "sobol-owen", "halton", "halton-scrambled"};
+
+// Joe and Kuo (2008) primitive polynomials and initial direction numbers
+// of coordinates 1 .. QMC_MAX_DIM - 1 (coordinate 0 is van der Corput)
+static const struct {
+    int s;          // Degree
+    uint32_t a;     // Inner coefficients
+    uint32_t m[5];
+} SOBOL_INIT[QMC_MAX_DIM - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+};
+
+static const uint32_t HALTON_BASES[QMC_MAX_DIM] = {2, 3, 5, 7, 11, 13, 17, 19};
+
+int qmc_kind_from_name(const char *name) {
+    for (int k = 0; k <= QMC_HALTON_SCRAMBLED; k++) {
+        if (strcmp(name, QMC_NAMES[k]) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+const char *qmc_kind_name(qmc_kind_t kind) {
+    return kind <= QMC_HALTON_SCRAMBLED ? QMC_NAMES[kind] : "unknown";
+}
+
+static uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Burley's hash-based nested uniform (Owen) scramble: the Laine-Karras
+// permutation flips every bit by a hash of the bits below it, so applied to
+// the reversed coordinate every digit is permuted by a function of the
+// digits above it
+static uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+static void sobol_directions(uint32_t *v, uint32_t dim) {
+    if (dim == 0) {
+        for (int k = 0; k < 32; k++) {
+            v[k] = UINT32_C(1) << (31 - k);
+        }
+        return;
+    }
+    int s = SOBOL_INIT[dim - 1].s;
+    uint32_t a = SOBOL_INIT[dim - 1].a;
+    for (int k = 0; k < s; k++) {
+        v[k] = SOBOL_INIT[dim - 1].m[k] << (31 - k);
+    }
+    for (int k = s; k < 32; k++) {
+        v[k] = v[k - s] ^ (v[k - s] >> s);
+        for (int j = 1; j < s; j++) {
+            if ((a >> (s - 1 - j)) & 1) {
+                v[k] ^= v[k - j];
+            }
+        }
+    }
+}
+
+int qmc_init(qmc_t *q, qmc_kind_t kind, uint32_t dim, uint64_t seed) {
+    memset(q, 0, sizeof *q);
+    if (kind == QMC_NONE || kind > QMC_HALTON_SCRAMBLED || dim >= QMC_MAX_DIM) {
+        return -1;
+    }
+    q->kind = kind;
+    q->dim = dim;
+    // Every coordinate scrambles with its own substream of the seed
+    rng_engine_t base, eng;
+    engine_init(&base, ENGINE_XOSHIRO256PP, seed);
+    engine_substream(&eng, &base, dim);
+    if (kind == QMC_SOBOL || kind == QMC_SOBOL_OWEN) {
+        sobol_directions(q->v, dim);
+        q->seed = (uint32_t)(engine_next_u64(&eng) >> 32);
+    } else {
+        q->base = HALTON_BASES[dim];
+        q->cell = 1;
+        q->low_span = 1;
+        while (q->digits < QMC_MAX_DIGITS && q->cell > 0x1p-52) {
+            q->cell /= q->base;
+            q->digits++;
+            if (q->low_span * q->base <= QMC_LOW_SPAN) {
+                q->low_span *= q->base;
+                q->low_cell = q->cell;
+                q->low_digits++;
+            }
+        }
+        for (int k = 0; k < q->digits; k++) {
+            // Fisher-Yates shuffle of the digits 0 .. base - 1
+            uint8_t *p = q->perm[k];
+            for (uint32_t j = 0; j < q->base; j++) {
+                p[j] = (uint8_t)j;
+            }
+            for (uint32_t j = q->base - 1; j > 0; j--) {
+                uint32_t r = (uint32_t)engine_next_bounded(&eng, j + 1);
+                uint8_t t = p[j];
+                p[j] = p[r];
+                p[r] = t;
+            }
+        }
+    }
+    qmc_seek(q, 0);
+    return 0;
+}
+
+// Sobol point number of sample index: the unscrambled sequences skip point 0
+static uint64_t sobol_point(const qmc_t *q, uint64_t index) {
+    return q->kind == QMC_SOBOL ? index + 1 : index;
+}
+
+void qmc_seek(qmc_t *q, uint64_t index) {
+    q->index = index;
+    if (q->kind == QMC_SOBOL || q->kind == QMC_SOBOL_OWEN) {
+        // Gray code order: point j is the XOR of the directions of the bits of j ^ (j >> 1)
+        uint64_t j = sobol_point(q, index);
+        uint64_t g = j ^ (j >> 1);
+        q->x = 0;
+        for (int k = 0; k < 32 && g != 0; k++, g >>= 1) {
+            if (g & 1) {
+                q->x ^= q->v[k];
+            }
+        }
+    }
+}
+
+void qmc_uniform(qmc_t *q, double *u, size_t n) {
+    switch (q->kind) {
+    case QMC_SOBOL:
+    case QMC_SOBOL_OWEN: {
+        uint64_t j = sobol_point(q, q->index);
+        uint32_t x = q->x;
+        for (size_t i = 0; i < n; i++, j++) {
+            // Scrambled points may be 0: centre them in their 2^-32 cell
+            u[i] = q->kind == QMC_SOBOL ? x * 0x1p-32 : (owen_scramble(x, q->seed) + 0.5) * 0x1p-32;
+            x ^= q->v[__builtin_ctzll(j + 1) & 31];
+        }
+        q->x = x;
+        break;
+    }
+    case QMC_HALTON:
+        for (size_t i = 0; i < n; i++) {
+            // Radical inverse of index + 1 in the base
+            uint64_t k = q->index + i + 1;
+            double f = 1.0 / q->base, r = 0;
+            for (; k != 0; k /= q->base) {
+                r += (double)(k % q->base) * f;
+                f /= q->base;
+            }
+            u[i] = r;
+        }
+        break;
+    default: {
+        // Every digit position, leading zeros included, goes through its
+        // permutation. The digits above the lowest low_digits only change
+        // every low_span points, so their part of the sum is kept per run.
+        uint64_t run = UINT64_MAX;
+        double high = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t k = q->index + i;
+            if (k / q->low_span != run) {
+                run = k / q->low_span;
+                high = 0.5 * q->cell; // Centre of the finest cell
+                uint64_t h = run;
+                double f = q->low_cell / q->base;
+                for (int d = q->low_digits; d < q->digits; d++, h /= q->base) {
+                    high += q->perm[d][h % q->base] * f;
+                    f /= q->base;
+                }
+            }
+            uint32_t l = (uint32_t)(k % q->low_span);
+            double f = 1.0 / q->base, r = high;
+            for (int d = 0; d < q->low_digits; d++, l /= q->base) {
+                r += q->perm[d][l % q->base] * f;
+                f /= q->base;
+            }
+            u[i] = r;
+        }
+        break;
+    }
+    }
+    q->index += n;
+}
+
+// Truncated normal by inversion inside the window; the window is mirrored
+// to the right of mu (truncnorm.c), so a > 0 means a tail window, which is
+// inverted from the upper tail where its probabilities keep their precision
+static void trunc_inverse(const truncnorm_t *tn, const double *u, double *out, size_t n) {
+    double sign = tn->mirrored ? -1 : 1;
+    if (tn->a > 0) {
+        double qa = normal_cdf(-tn->a), qb = normal_cdf(-tn->b);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = tn->mu - sign * tn->sigma * normal_quantile(qa - u[i] * (qa - qb));
+        }
+    } else {
+        double pa = normal_cdf(tn->a), pb = normal_cdf(tn->b);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = tn->mu + sign * tn->sigma * normal_quantile(pa + u[i] * (pb - pa));
+        }
+    }
+}
+
+void qmc_dist_fill_int(qmc_t *q, const batch_dist_t *d, int *out, size_t n) {
+    INSTR_ADD(INSTR_SAMPLES + d->type, n);
+    double u[QMC_BLOCK];
+    for (size_t done = 0; done < n; done += QMC_BLOCK) {
+        size_t len = n - done < QMC_BLOCK ? n - done : QMC_BLOCK;
+        int *o = out + done;
+        qmc_uniform(q, u, len);
+        switch (d->type) {
+        case DIST_UNIFORM_INT: {
+            // range 0 stands for all 2^32 values
+            double range = d->range != 0 ? (double)d->range : 0x1p32;
+            for (size_t i = 0; i < len; i++) {
+                uint32_t k = (uint32_t)(u[i] * range);
+                o[i] = (int)((uint32_t)d->lo + (d->range != 0 && k >= d->range ? d->range - 1 : k));
+            }
+            break;
+        }
+        case DIST_NORMAL_INT:
+            for (size_t i = 0; i < len; i++) {
+                o[i] = (int)round(d->mu + d->sigma * normal_quantile(u[i]));
+            }
+            break;
+        default: {
+            double x[QMC_BLOCK];
+            trunc_inverse(&d->tn, u, x, len);
+            for (size_t i = 0; i < len; i++) {
+                // round() sends the exact upper edge max + 0.5 to max + 1
+                int v = (int)round(x[i]);
+                o[i] = v < d->tn.min_int ? d->tn.min_int : (v > d->tn.max_int ? d->tn.max_int : v);
+            }
+            break;
+        }
+        }
+    }
+}
+
+void qmc_dist_fill(qmc_t *q, const batch_dist_t *d, double *out, size_t n) {
+    if (dist_is_integer(d->type)) {
+        int v[QMC_BLOCK];
+        for (size_t done = 0; done < n; done += QMC_BLOCK) {
+            size_t len = n - done < QMC_BLOCK ? n - done : QMC_BLOCK;
+            qmc_dist_fill_int(q, d, v, len);
+            for (size_t i = 0; i < len; i++) {
+                out[done + i] = v[i];
+            }
+        }
+        return;
+    }
+    INSTR_ADD(INSTR_SAMPLES + d->type, n);
+    qmc_uniform(q, out, n);
+    switch (d->type) {
+    case DIST_UNIFORM_REAL:
+        for (size_t i = 0; i < n; i++) {
+            out[i] = d->m + d->scale * out[i];
+        }
+        break;
+    case DIST_NORMAL_REAL:
+        for (size_t i = 0; i < n; i++) {
+            out[i] = d->mu + d->sigma * normal_quantile(out[i]);
+        }
+        break;
+    default:
+        trunc_inverse(&d->tn, out, out, n);
+        break;
+    }
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * File: qmc.h
+ *
+ * Purpose:
+ * Quasi-random (low-discrepancy) sample source, as a drop-in replacement
+ * for the engine when only the shape of a dataset matters: histograms,
+ * means and standard deviations converge like (log N) / N instead of
+ * 1 / sqrt(N), so they look smooth with far fewer samples.
+ *
+ * Sequences:
+ * 1. **Sobol**: Joe and Kuo direction numbers, points in Gray code order
+ *    (Antonov-Saleev), 32 bits per coordinate. The unscrambled sequence
+ *    starts at point 1, so that no sample sits at 0.
+ * 2. **Sobol, Owen scrambled**: nested uniform scrambling by Burley's (2020)
+ *    hash, seeded from the run's engine. Scrambling keeps the net structure
+ *    and makes the estimates unbiased, so runs with different seeds give
+ *    independent error estimates.
+ * 3. **Halton**: radical inverse in the prime base of the coordinate,
+ *    starting at point 1.
+ * 4. **Halton, scrambled**: one random permutation of the digits per base
+ *    and digit position (random digital scrambling), seeded likewise.
+ *
+ * Each coordinate (dimension) of a sequence is an independent stream:
+ * the files of an rns job and the columns of rng use coordinates 0, 1, ...
+ * so they are jointly well spread. Every sample uses one coordinate value
+ * and is mapped by inversion: uniform by scaling, normal by the normal
+ * quantile function, truncated normal by inverting the CDF inside the
+ * window, integers by rounding, as in the engine samplers. Point i depends
+ * only on i, so chunks can be generated in any order (qmc_seek).
+ *
+ *****************************************************************************/
+#ifndef QMC_H
+#define QMC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batch.h"
+
+typedef enum {
+    QMC_NONE = 0,           // Pseudo-random: draw from the engine
+    QMC_SOBOL = 1,
+    QMC_SOBOL_OWEN = 2,
+    QMC_HALTON = 3,
+    QMC_HALTON_SCRAMBLED = 4
+} qmc_kind_t;
+
+// Coordinates available (Halton bases 2 .. 19)
+#define QMC_MAX_DIM 8
+#define QMC_MAX_BASE 19
+// Scrambled Halton digits per point: enough for 2^-52 in base 2
+#define QMC_MAX_DIGITS 52
+// Scrambled Halton: the digits of index mod at most this many change point by point
+#define QMC_LOW_SPAN 65536
+// Points per stream (Sobol coordinates have 32 bits)
+#define QMC_MAX_POINTS UINT64_C(0xFFFFFFFF)
+
+typedef struct {
+    qmc_kind_t kind;
+    uint32_t dim;
+    uint64_t index;         // Next point
+    uint32_t x;             // Sobol: coordinate of the next point, unscrambled
+    uint32_t v[32];         // Sobol direction numbers
+    uint32_t seed;          // Sobol: Owen scrambling seed
+    uint32_t base;          // Halton: prime base of the coordinate
+    int digits;             // Halton scrambled: digits per point ...
+    double cell;            // ... and base^-digits
+    int low_digits;         // Lowest digits, worked out for every point ...
+    uint32_t low_span;      // ... base^low_digits ...
+    double low_cell;        // ... and base^-low_digits
+    uint8_t perm[QMC_MAX_DIGITS][QMC_MAX_BASE]; // Halton scrambled: digit permutations
+} qmc_t;
+
+// Parse a sequence name ("prng", "sobol", "sobol-owen", "halton",
+// "halton-scrambled"); -1 if unknown
+int qmc_kind_from_name(const char *name);
+// Human readable sequence name
+const char *qmc_kind_name(qmc_kind_t kind);
+// Set up coordinate dim of a sequence at point 0; scrambling is drawn from
+// seed. -1 for QMC_NONE, an unknown kind or dim >= QMC_MAX_DIM.
+int qmc_init(qmc_t *q, qmc_kind_t kind, uint32_t dim, uint64_t seed);
+// Move to point index
+void qmc_seek(qmc_t *q, uint64_t index);
+// Next n points, in (0, 1)
+void qmc_uniform(qmc_t *q, double *u, size_t n);
+// Next n samples of d by inversion (integer types are widened to double)
+void qmc_dist_fill(qmc_t *q, const batch_dist_t *d, double *out, size_t n);
+// Next n samples of d, which must be an integer type
+void qmc_dist_fill_int(qmc_t *q, const batch_dist_t *d, int *out, size_t n);
+
+#endif
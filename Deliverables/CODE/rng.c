@@ -14,7 +14,7 @@
  * 
  * Features:
  * - Generates random numbers using the above distributions.
- * - Outputs the generated values to the console.
+ * - Outputs a sample of the generated values (first and last rows) to the console.
  * - Writes a set of random sequences to a file in tab-separated format.
  * 
  * Output:
@@ -22,8 +22,22 @@
  * - A file "output.txt" containing generated sequences in tabular form.
  * 
  * Usage: (Updated Since I Changed The File Name)
- * - Compile: gcc rng.c -lm -o r
- * - Execute: ./r
+ * - Compile: gcc rng.c engine.c normal.c truncnorm.c alias.c batch.c qmc.c instr.c writer.c dataset.c stats.c -lm -lpthread -o r
+ * - Execute: ./r [-s seed] [-e xoshiro|philox] [-n ziggurat|boxmuller] [-q sequence] [-b] [-k rows] [-p params]
+ *   -b also writes each distribution to output_<name>.bin (see dataset.h).
+ *   -p m,M,mu,sigma,min_int,max_int,min_real,max_real,N gives the nine inputs
+ *   on the command line instead of answering the prompts.
+ *   -k echoes only the first and last `rows` rows to the console (default 10;
+ *   0 echoes none, -1 every row). output.txt always gets every row, written
+ *   by a background I/O thread while the next block is generated.
+ *   Without -s the seed is taken from the clock and printed so the run can be
+ *   reproduced.
+ *   -q sobol|sobol-owen|halton|halton-scrambled draws every column from a
+ *   quasi-random sequence instead of the engine (column k uses coordinate k,
+ *   see qmc.h); the means and standard deviations then settle with far
+ *   fewer rows. The scrambled sequences take their scrambling from the seed.
+ *   Built with make INSTRUMENT=1 (or -DRNG_INSTRUMENT), every run also writes
+ *   a JSON report of where the time went to rng_report.json (see instr.h).
  * - I used "r" because it is shorter to call in the executable but you can easily change it.
  * 
  * Experimentation Instructions:
@@ -36,221 +50,403 @@
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
-// Macro for generating random real numbers uniformly in [0, 1)
-#define frand() (rand() / (double)RAND_MAX) 
+#include "engine.h"
+#include "normal.h"
+#include "truncnorm.h"
+#include "batch.h"
+#include "qmc.h"
+#include "writer.h"
+#include "dataset.h"
+#include "dist.h"
+#include "stats.h"
+#include "instr.h"
 
-// Macro for generating random real numbers from a normal distribution
-#define nrand() (sqrt(-2 * log(frand())) * cos(2 * 3.141592653589793238 * frand()))
+// Rows generated per block: statistics are updated as each block is produced,
+// so memory use does not grow with N
+#define RNG_BLOCK 4096
+// Rows echoed to the console at each end of the run unless -k says otherwise
+#define RNG_ECHO_ROWS 10
+
+// One row of output.txt, kept for the console echo
+typedef struct {
+    double uniform_real, normal_real, trunc_real;
+    int uniform_int, trunc_int;
+} rng_row_t;
 
 // Function Prototypes
-// Generate a random real number uniformly distributed in [m, M]
-double generate_uniform_real(double m, double M);
-// Generate a random integer uniformly distributed in [m, M]
-double generate_uniform_int(double m, double M);
-// Generate a random real number from a normal distribution
-double generate_normal(double mu, double sigma);
-// Generate a random real integer number from a normal distribution
-double generate_normal_int(double mu, double sigma);
-// Generate a random integer from a truncated normal distribution
-int generate_truncated_normal_int(double mu, double sigma, int min, int max);
-// Generate a random real number from a truncated normal distribution
-double generate_truncated_normal_real(double mu, double sigma, double min, double max);
-
-// Calculate the mean of an array of numbers
-double calculate_mean(double *values, int N);
-// Calculate the standard deviation of an array of numbers
-double calculate_stddev(double *values, int N);
-// Write generated random values to the file
-void write_to_file(FILE *f, double s2, double s3, int s4, double s5);
 // Validate user inputs for correctness
-void validate_input(double m, double M, double sigma, int N);
+void validate_input(double m, double M, double sigma, long long N);
+// Create output_<name>.bin for one distribution and an asynchronous writer to append samples with
+// (q is the column's quasi-random sequence, or NULL when it draws from eng)
+void open_binary(text_writer_t *w, int type, long long N, double mu, double sigma, double m, double M, const rng_engine_t *eng, const qmc_t *q);
+// Print one row to the console: "%-20.5f%-20.5f%-20d%-20d%-20.5f%-20d\n"
+void echo_row(text_writer_t *con, const rng_row_t *row);
+
+int main(int argc, char *argv[]) {
+    INSTR_BEGIN(argc, argv);
+    uint64_t seed = (uint64_t)time(NULL); // Default: seed from the current time
+    engine_kind_t kind = ENGINE_XOSHIRO256PP;
+    normal_method_t method = NORMAL_ZIGGURAT;
+    int binary = 0;
+    qmc_kind_t sequence = QMC_NONE;
+    long long echo = RNG_ECHO_ROWS;
+    const char *params = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:e:n:q:bk:p:")) != -1) {
+        switch (opt) {
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            if (engine_kind_from_name(optarg) < 0) {
+                fprintf(stderr, "Error: Unknown engine '%s' (use xoshiro or philox).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            kind = (engine_kind_t)engine_kind_from_name(optarg);
+            break;
+        case 'n':
+            if (normal_method_from_name(optarg) < 0) {
+                fprintf(stderr, "Error: Unknown normal method '%s' (use ziggurat or boxmuller).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            method = (normal_method_t)normal_method_from_name(optarg);
+            break;
+        case 'q':
+            if (qmc_kind_from_name(optarg) < 0) {
+                fprintf(stderr, "Error: Unknown sequence '%s' (use prng, sobol, sobol-owen, halton or halton-scrambled).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            sequence = (qmc_kind_t)qmc_kind_from_name(optarg);
+            break;
+        case 'b':
+            binary = 1;
+            break;
+        case 'k':
+            echo = atoll(optarg);
+            break;
+        case 'p':
+            params = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s seed] [-e xoshiro|philox] [-n ziggurat|boxmuller] [-q sequence] [-b] [-k rows] [-p m,M,mu,sigma,min_int,max_int,min_real,max_real,N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-int main() {
-    srand(time(NULL)); // Seed the random number generator with the current time
+    // Every generator draws from this explicit engine handle
+    rng_engine_t eng;
+    engine_init(&eng, kind, seed);
+    eng.normal_method = method;
+    printf("Engine: %s, normal: %s, seed: %llu\n", engine_kind_name(kind), normal_method_name(method),
+           (unsigned long long)seed);
+    if (sequence != QMC_NONE) {
+        printf("Sequence: %s\n", qmc_kind_name(sequence));
+    }
 
     // Variables for ranges, distributions, and number of samples
     double m, M, mu, sigma;
-    int N, min_int, max_int;
+    long long N;
+    int min_int, max_int;
     double min_real, max_real;
 
-    // Input for uniform distribution range
-    printf("Enter the minimum value (m) for uniform distributions: ");
-    scanf("%lf", &m);
-    printf("Enter the maximum value (M) for uniform distributions: ");
-    scanf("%lf", &M);
-
-    // Input for normal distribution parameters
-    printf("Enter the mean (mu) for the normal distribution: ");
-    scanf("%lf", &mu);
-    printf("Enter the standard deviation (sigma) for the normal distribution: ");
-    scanf("%lf", &sigma);
-
-    // Input for truncated normal ranges
-    printf("Enter the minimum integer value for truncated normal distribution: ");
-    scanf("%d", &min_int);
-    printf("Enter the maximum integer value for truncated normal distribution: ");
-    scanf("%d", &max_int);
-    printf("Enter the minimum real value for truncated normal distribution: ");
-    scanf("%lf", &min_real);
-    printf("Enter the maximum real value for truncated normal distribution: ");
-    scanf("%lf", &max_real);
-
-    // Input for the number of random numbers to generate
-    printf("Enter the number of random sequences (N) to generate: ");
-    scanf("%d", &N);
+    if (params != NULL) {
+        // All nine parameters on the command line: no prompts, so runs can be scripted
+        if (sscanf(params, "%lf,%lf,%lf,%lf,%d,%d,%lf,%lf,%lld", &m, &M, &mu, &sigma, &min_int, &max_int, &min_real,
+                   &max_real, &N) != 9) {
+            fprintf(stderr, "Error: -p expects m,M,mu,sigma,min_int,max_int,min_real,max_real,N.\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Input for uniform distribution range
+        printf("Enter the minimum value (m) for uniform distributions: ");
+        scanf("%lf", &m);
+        printf("Enter the maximum value (M) for uniform distributions: ");
+        scanf("%lf", &M);
+
+        // Input for normal distribution parameters
+        printf("Enter the mean (mu) for the normal distribution: ");
+        scanf("%lf", &mu);
+        printf("Enter the standard deviation (sigma) for the normal distribution: ");
+        scanf("%lf", &sigma);
+
+        // Input for truncated normal ranges
+        printf("Enter the minimum integer value for truncated normal distribution: ");
+        scanf("%d", &min_int);
+        printf("Enter the maximum integer value for truncated normal distribution: ");
+        scanf("%d", &max_int);
+        printf("Enter the minimum real value for truncated normal distribution: ");
+        scanf("%lf", &min_real);
+        printf("Enter the maximum real value for truncated normal distribution: ");
+        scanf("%lf", &max_real);
+
+        // Input for the number of random numbers to generate
+        printf("Enter the number of random sequences (N) to generate: ");
+        scanf("%lld", &N);
+    }
 
     // Validate inputs
     validate_input(m, M, sigma, N);
 
+    // One distribution object per column: ranges, thresholds, alias tables and
+    // truncation strategies are all worked out here, once
+    batch_dist_t d_uniform_real, d_normal_real, d_uniform_int, d_normal_int, d_trunc_int, d_trunc_real;
+    batch_dist_init(&d_uniform_real, DIST_UNIFORM_REAL, m, M, mu, sigma);
+    batch_dist_init(&d_normal_real, DIST_NORMAL_REAL, m, M, mu, sigma);
+    batch_dist_init(&d_normal_int, DIST_NORMAL_INT, m, M, mu, sigma);
+    if (batch_dist_init(&d_uniform_int, DIST_UNIFORM_INT, min_int, max_int, mu, sigma) != 0 ||
+        batch_dist_init(&d_trunc_int, DIST_TRUNC_INT, min_int, max_int, mu, sigma) != 0 ||
+        batch_dist_init(&d_trunc_real, DIST_TRUNC_REAL, min_real, max_real, mu, sigma) != 0) {
+        fprintf(stderr, "Error: Truncation ranges must satisfy minimum <= maximum.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Quasi-random columns: coordinate k of the sequence for column k, in fill order
+    qmc_t q[6];
+    if (sequence != QMC_NONE) {
+        if ((unsigned long long)N > QMC_MAX_POINTS) {
+            fprintf(stderr, "Error: %s has fewer than N points.\n", qmc_kind_name(sequence));
+            return EXIT_FAILURE;
+        }
+        rng_engine_t scramble = eng;
+        uint64_t scramble_seed = engine_next_u64(&scramble);
+        for (uint32_t k = 0; k < 6; k++) {
+            qmc_init(&q[k], sequence, k, scramble_seed);
+        }
+    }
+    const qmc_t *qcol = sequence != QMC_NONE ? q : NULL;
+
     // Output filename to save the generated sequences
     char filename[50] = "output.txt";
 
-    // Open a file to write the random sequences
-    FILE *f = fopen(filename, "w"); // Open file in write mode
-    if (f == NULL) {
+    // Open a file to write the random sequences (buffered; the write() calls run on an I/O thread)
+    text_writer_t f, con;
+    if (writer_open(&f, filename) != 0) {
         perror("Error opening file");
         return EXIT_FAILURE;
     }
+    writer_start_async(&f);
+    fflush(stdout); // The console writer shares fd 1 with printf
+    writer_attach(&con, STDOUT_FILENO);
 
-    // Arrays to store values for calculating mean and stddev for each distribution
-    double *uniform_real_vals = (double *)malloc(N * sizeof(double));
-    double *normal_real_vals = (double *)malloc(N * sizeof(double));
-    double *uniform_int_vals = (double *)malloc(N * sizeof(double));
-    double *normal_int_vals = (double*)malloc(N * sizeof(double));
-    int *truncated_normal_int_vals = (int *)malloc(N * sizeof(int));
-    double *truncated_normal_real_vals = (double *)malloc(N * sizeof(double));
+    // One block of each distribution, reused for the whole run
+    double uniform_real_vals[RNG_BLOCK], normal_real_vals[RNG_BLOCK], truncated_normal_real_vals[RNG_BLOCK];
+    int uniform_int_vals[RNG_BLOCK], normal_int_vals[RNG_BLOCK], truncated_normal_int_vals[RNG_BLOCK];
 
-    // Write column headers to the file and console for clarity
-    fprintf(f, "Continuous Real\tNormal Real\tUniform Int\tNormal Int\tTrunc Int\tTrunc Real\n");
-    printf("\n%-20s%-20s%-20s%-20s%-20s%-20s\n", "Continuous Real", "Normal Real", "Uniform Int", "Normal Int", "Trunc Int", "Trunc Real");
-    printf("--------------------------------------------------------------------------------------------------------------------\n");
-
-    // Generate random values and store them in arrays for mean and stddev calculation
-    for (int i = 0; i < N; i++) {
-        double s2 = generate_uniform_real(m, M);
-        double s3 = generate_normal(mu, sigma);
-        int s4 = generate_uniform_int(min_int, max_int);
-        int s1 = generate_normal_int(mu, sigma);
-        int s5 = generate_truncated_normal_int(mu, sigma, min_int, max_int);
-        double s6 = generate_truncated_normal_real(mu, sigma, min_real, max_real);
-
-        // Store the values for later mean and stddev calculation
-        normal_int_vals[i] = s1;
-        uniform_real_vals[i] = s2;
-        normal_real_vals[i] = s3;
-        uniform_int_vals[i] = s4;
-        truncated_normal_int_vals[i] = s5;
-        truncated_normal_real_vals[i] = s6;
-        
-        // Write the values to the file and print to the console
-        fprintf(f, "%.5f\t%.5f\t%d\t%d\t%.5f\t%d\n", s2, s3, s4, s5, s6, s5);
-        printf("%-20.5f%-20.5f%-20d%-20d%-20.5f%-20d\n", s2, s3, s4, s5, s6, s5);
+    // Running mean/stddev for each distribution, updated block by block
+    stats_acc_t st_uniform_real, st_normal_real, st_uniform_int, st_normal_int, st_trunc_int, st_trunc_real;
+    stats_init(&st_uniform_real);
+    stats_init(&st_normal_real);
+    stats_init(&st_uniform_int);
+    stats_init(&st_normal_int);
+    stats_init(&st_trunc_int);
+    stats_init(&st_trunc_real);
+
+    // Optional binary datasets, appended block by block
+    text_writer_t bin_out[6];
+    if (binary) {
+        open_binary(&bin_out[0], DIST_UNIFORM_REAL, N, mu, sigma, m, M, &eng, qcol != NULL ? &qcol[0] : NULL);
+        open_binary(&bin_out[1], DIST_NORMAL_REAL, N, mu, sigma, m, M, &eng, qcol != NULL ? &qcol[1] : NULL);
+        open_binary(&bin_out[2], DIST_UNIFORM_INT, N, mu, sigma, min_int, max_int, &eng, qcol != NULL ? &qcol[2] : NULL);
+        open_binary(&bin_out[3], DIST_NORMAL_INT, N, mu, sigma, m, M, &eng, qcol != NULL ? &qcol[3] : NULL);
+        open_binary(&bin_out[4], DIST_TRUNC_INT, N, mu, sigma, min_int, max_int, &eng, qcol != NULL ? &qcol[4] : NULL);
+        open_binary(&bin_out[5], DIST_TRUNC_REAL, N, mu, sigma, min_real, max_real, &eng, qcol != NULL ? &qcol[5] : NULL);
     }
 
-    // Calculate and print the mean and standard deviation for each distribution
-    double mean_uniform_real = calculate_mean(uniform_real_vals, N);
-    double stddev_uniform_real = calculate_stddev(uniform_real_vals, N);
-    double mean_normal_real = calculate_mean(normal_real_vals, N);
-    double stddev_normal_real = calculate_stddev(normal_real_vals, N);
-    double mean_normal_int = calculate_mean((double*)normal_int_vals, N);
-    double stddev_normal_int = calculate_stddev((double*)normal_int_vals, N);
-    double mean_uniform_int = calculate_mean((double *)uniform_int_vals, N);  // Cast to double for consistency
-    double stddev_uniform_int = calculate_stddev((double *)uniform_int_vals, N);
-    double mean_truncated_normal_int = calculate_mean((double *)truncated_normal_int_vals, N);
-    double stddev_truncated_normal_int = calculate_stddev((double *)truncated_normal_int_vals, N);
-    double mean_truncated_normal_real = calculate_mean(truncated_normal_real_vals, N);
-    double stddev_truncated_normal_real = calculate_stddev(truncated_normal_real_vals, N);
-
-    // Print results for each distribution
-    printf("\n\nMean and Standard Deviation for each distribution:\n-------------------------------------------------------------\n");
-    printf("Uniform Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_uniform_real, stddev_uniform_real);
-    printf("Normal Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_normal_real, stddev_normal_real);
-    printf("Uniform Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_uniform_int, stddev_uniform_int);
-    printf("Normal Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_normal_int, stddev_normal_int);
-    printf("Truncated Normal Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_truncated_normal_int, stddev_truncated_normal_int);
-    printf("Truncated Normal Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_truncated_normal_real, stddev_truncated_normal_real);
-
-    // Output the mean and stddev for each distribution to the file
-    fprintf(f, "\n\nMean and Standard Deviation for each distribution:\n-------------------------------------------------------------\n");
-    fprintf(f, "Uniform Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_uniform_real, stddev_uniform_real);
-    fprintf(f, "Normal Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_normal_real, stddev_normal_real);
-    fprintf(f, "Uniform Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_uniform_int, stddev_uniform_int);
-    fprintf(f, "Normal Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_normal_int, stddev_normal_int);
-    fprintf(f, "Truncated Normal Int:\nMean = %.5f\nStddev = %.5f\n\n", mean_truncated_normal_int, stddev_truncated_normal_int);
-    fprintf(f, "Truncated Normal Real:\nMean = %.5f\nStddev = %.5f\n\n", mean_truncated_normal_real, stddev_truncated_normal_real);
-
-    fclose(f); // Close the file after writing
-    free(uniform_real_vals);
-    free(normal_real_vals);
-    free(uniform_int_vals);
-    free(normal_int_vals);
-    free(truncated_normal_int_vals);
-    free(truncated_normal_real_vals);
+    // Console echo: the first rows go out as they are made, the last ones are
+    // kept in a ring and printed at the end, so the terminal never holds up generation
+    long long head_rows = echo < 0 ? N : echo;
+    long long tail_rows = echo < 0 ? 0 : echo;
+    rng_row_t *tail = tail_rows > 0 ? malloc((size_t)tail_rows * sizeof(rng_row_t)) : NULL;
+    if (tail_rows > 0 && tail == NULL) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return EXIT_FAILURE;
+    }
 
-    return 0;
-}
+    // Write column headers to the file and console for clarity
+    writer_put_str(&f, "Continuous Real\tNormal Real\tUniform Int\tNormal Int\tTrunc Int\tTrunc Real\n");
+    char header[160];
+    snprintf(header, sizeof(header), "\n%-20s%-20s%-20s%-20s%-20s%-20s\n", "Continuous Real", "Normal Real", "Uniform Int", "Normal Int", "Trunc Int", "Trunc Real");
+    writer_put_str(&con, header);
+    writer_put_str(&con, "--------------------------------------------------------------------------------------------------------------------\n");
 
-// Generate a random real number uniformly distributed in [m, M]
-double generate_uniform_real(double m, double M) {
-    return m + (M - m) * frand();
-}
+    for (long long done = 0; done < N; done += RNG_BLOCK) {
+        int len = N - done < RNG_BLOCK ? (int)(N - done) : RNG_BLOCK;
 
-// Generate a random integer uniformly distributed in [m, M]
-double generate_uniform_int(double m, double M) {
-    int rand_val = m + (int)(frand() * (M - m + 1));  // Ensures the integer is within range
-return rand_val;
-//printf("Uniform rand_val: %.5d\n", rand_val);  // Debugging output
-}
-// Generate a random real number from a normal distribution
-double generate_normal(double mu, double sigma) {
-    return nrand() * sigma + mu;
-}
-// Generate a random real integer from a normal distribution
-double generate_normal_int(double m, double sigma) {
-    double norm_val = generate_normal(m, sigma);
-    //printf("Normal rand_val: %.5f\n", norm_val);  // Debugging output
-    return (int)round(norm_val);
-}
-// Generate a random integer from a truncated normal distribution
-int generate_truncated_normal_int(double mu, double sigma, int min, int max) {
-    int value;
-    do {
-        value = (int)round(nrand() * sigma + mu);
-    } while (value < min || value > max);
-    return value;
-}
+        // Fill one block of each distribution (vectorised mapping, no per-sample calls)
+        INSTR_TIME_START(t_gen);
+        if (sequence != QMC_NONE) {
+            qmc_dist_fill(&q[0], &d_uniform_real, uniform_real_vals, len);
+            qmc_dist_fill(&q[1], &d_normal_real, normal_real_vals, len);
+            qmc_dist_fill_int(&q[2], &d_uniform_int, uniform_int_vals, len);
+            qmc_dist_fill_int(&q[3], &d_normal_int, normal_int_vals, len);
+            qmc_dist_fill_int(&q[4], &d_trunc_int, truncated_normal_int_vals, len);
+            qmc_dist_fill(&q[5], &d_trunc_real, truncated_normal_real_vals, len);
+        } else {
+            batch_dist_fill(&d_uniform_real, &eng, uniform_real_vals, len);
+            batch_dist_fill(&d_normal_real, &eng, normal_real_vals, len);
+            batch_dist_fill_int(&d_uniform_int, &eng, uniform_int_vals, len);
+            batch_dist_fill_int(&d_normal_int, &eng, normal_int_vals, len);
+            batch_dist_fill_int(&d_trunc_int, &eng, truncated_normal_int_vals, len);
+            batch_dist_fill(&d_trunc_real, &eng, truncated_normal_real_vals, len);
+        }
+        INSTR_TIME_STOP(t_gen, INSTR_GENERATE);
 
-// Generate a random real number from a truncated normal distribution
-double generate_truncated_normal_real(double mu, double sigma, double min, double max) {
-    double value;
-    do {
-        value = nrand() * sigma + mu;
-    } while (value < min || value > max);
-    return value;
-}
+        // Update the statistics while the block is still in cache
+        INSTR_TIME_START(t_sum);
+        stats_push_batch(&st_uniform_real, uniform_real_vals, len);
+        stats_push_batch(&st_normal_real, normal_real_vals, len);
+        stats_push_batch_int(&st_uniform_int, uniform_int_vals, len);
+        stats_push_batch_int(&st_normal_int, normal_int_vals, len);
+        stats_push_batch_int(&st_trunc_int, truncated_normal_int_vals, len);
+        stats_push_batch(&st_trunc_real, truncated_normal_real_vals, len);
+        INSTR_TIME_STOP(t_sum, INSTR_SUMMARISE);
 
-// Function to calculate mean
-double calculate_mean(double *values, int N) {
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-        sum += values[i];
+        INSTR_TIME_START(t_fmt);
+        if (binary) {
+            writer_put(&bin_out[0], (const char *)uniform_real_vals, len * sizeof(double));
+            writer_put(&bin_out[1], (const char *)normal_real_vals, len * sizeof(double));
+            writer_put(&bin_out[2], (const char *)uniform_int_vals, len * sizeof(int));
+            writer_put(&bin_out[3], (const char *)normal_int_vals, len * sizeof(int));
+            writer_put(&bin_out[4], (const char *)truncated_normal_int_vals, len * sizeof(int));
+            writer_put(&bin_out[5], (const char *)truncated_normal_real_vals, len * sizeof(double));
+        }
+
+        for (int i = 0; i < len; i++) {
+            double s2 = uniform_real_vals[i];
+            double s3 = normal_real_vals[i];
+            int s4 = uniform_int_vals[i];
+            int s5 = truncated_normal_int_vals[i];
+            double s6 = truncated_normal_real_vals[i];
+
+            // Write the values to the file: "%.5f\t%.5f\t%d\t%d\t%.5f\t%d\n"
+            writer_put_fixed(&f, s2, 5);
+            writer_put_char(&f, '\t');
+            writer_put_fixed(&f, s3, 5);
+            writer_put_char(&f, '\t');
+            writer_put_int(&f, s4);
+            writer_put_char(&f, '\t');
+            writer_put_int(&f, s5);
+            writer_put_char(&f, '\t');
+            writer_put_fixed(&f, s6, 5);
+            writer_put_char(&f, '\t');
+            writer_put_int(&f, s5);
+            writer_put_char(&f, '\n');
+
+            // ... and echo the first and last rows to the console
+            long long row = done + i;
+            if (row < head_rows || tail_rows > 0) {
+                rng_row_t r = {s2, s3, s6, s4, s5};
+                if (row < head_rows) {
+                    echo_row(&con, &r);
+                } else {
+                    tail[(row - head_rows) % tail_rows] = r;
+                }
+            }
+        }
+        INSTR_TIME_STOP(t_fmt, INSTR_FORMAT);
+    }
+    if (tail_rows > 0 && N > head_rows) {
+        long long kept = N - head_rows < tail_rows ? N - head_rows : tail_rows;
+        if (N - head_rows > kept) {
+            char skipped[80];
+            snprintf(skipped, sizeof(skipped), "... %lld rows not shown ...\n", N - head_rows - kept);
+            writer_put_str(&con, skipped);
+        }
+        for (long long k = N - head_rows - kept; k < N - head_rows; k++) {
+            echo_row(&con, &tail[k % tail_rows]);
+        }
+    }
+    free(tail);
+    if (binary) {
+        for (int k = 0; k < 6; k++) {
+            if (writer_close(&bin_out[k]) != 0) {
+                perror("Error writing binary file");
+                return EXIT_FAILURE;
+            }
+        }
     }
-    return sum / N;
+
+    // Mean and standard deviation for each distribution
+    double mean_uniform_real = stats_mean(&st_uniform_real);
+    double stddev_uniform_real = stats_stddev(&st_uniform_real);
+    double mean_normal_real = stats_mean(&st_normal_real);
+    double stddev_normal_real = stats_stddev(&st_normal_real);
+    double mean_normal_int = stats_mean(&st_normal_int);
+    double stddev_normal_int = stats_stddev(&st_normal_int);
+    double mean_uniform_int = stats_mean(&st_uniform_int);
+    double stddev_uniform_int = stats_stddev(&st_uniform_int);
+    double mean_truncated_normal_int = stats_mean(&st_trunc_int);
+    double stddev_truncated_normal_int = stats_stddev(&st_trunc_int);
+    double mean_truncated_normal_real = stats_mean(&st_trunc_real);
+    double stddev_truncated_normal_real = stats_stddev(&st_trunc_real);
+
+    // Results for each distribution, written to both the console and the file
+    char summary[1024];
+    snprintf(summary, sizeof(summary),
+             "\n\nMean and Standard Deviation for each distribution:\n-------------------------------------------------------------\n"
+             "Uniform Real:\nMean = %.5f\nStddev = %.5f\n\n"
+             "Normal Real:\nMean = %.5f\nStddev = %.5f\n\n"
+             "Uniform Int:\nMean = %.5f\nStddev = %.5f\n\n"
+             "Normal Int:\nMean = %.5f\nStddev = %.5f\n\n"
+             "Truncated Normal Int:\nMean = %.5f\nStddev = %.5f\n\n"
+             "Truncated Normal Real:\nMean = %.5f\nStddev = %.5f\n\n",
+             mean_uniform_real, stddev_uniform_real, mean_normal_real, stddev_normal_real,
+             mean_uniform_int, stddev_uniform_int, mean_normal_int, stddev_normal_int,
+             mean_truncated_normal_int, stddev_truncated_normal_int,
+             mean_truncated_normal_real, stddev_truncated_normal_real);
+    writer_put_str(&con, summary);
+    writer_put_str(&f, summary);
+
+    writer_close(&con);
+    if (writer_close(&f) != 0) { // Close the file after writing
+        perror("Error writing file");
+        return EXIT_FAILURE;
+    }
+
+    INSTR_REPORT();
+    return 0;
 }
 
-// Function to calculate standard deviation
-double calculate_stddev(double *values, int N) {
-    double mean = calculate_mean(values, N);
-    double sum_of_squares = 0;
-    for (int i = 0; i < N; i++) {
-        sum_of_squares += pow(values[i] - mean, 2);
+// Create output_<name>.bin for one distribution and an asynchronous writer to append samples with
+void open_binary(text_writer_t *w, int type, long long N, double mu, double sigma, double m, double M, const rng_engine_t *eng, const qmc_t *q) {
+    dataset_header_t hdr;
+    char path[64];
+    dataset_header_init(&hdr, dist_is_integer(type) ? DS_INT32 : DS_FLOAT64, (uint64_t)N);
+    hdr.distribution = (uint32_t)type;
+    hdr.engine = (uint32_t)eng->kind;
+    hdr.normal_method = (uint32_t)eng->normal_method;
+    hdr.mu = mu;
+    hdr.sigma = sigma;
+    hdr.m = m;
+    hdr.M = M;
+    hdr.seed = eng->seed;
+    hdr.sequence = q != NULL ? (uint32_t)q->kind : QMC_NONE;
+    hdr.dimension = q != NULL ? q->dim : 0;
+    snprintf(path, sizeof(path), "output_%s.bin", dist_file_name(type));
+    int fd = dataset_create(path, &hdr);
+    if (fd < 0 || writer_attach(w, fd) != 0) {
+        exit(EXIT_FAILURE);
     }
-    return sqrt(sum_of_squares / (N - 1));
+    w->owns_fd = 1;
+    writer_start_async(w);
+}
+
+// Print one row to the console: "%-20.5f%-20.5f%-20d%-20d%-20.5f%-20d\n"
+void echo_row(text_writer_t *con, const rng_row_t *row) {
+    writer_put_fixed_padded(con, row->uniform_real, 5, 20);
+    writer_put_fixed_padded(con, row->normal_real, 5, 20);
+    writer_put_int_padded(con, row->uniform_int, 20);
+    writer_put_int_padded(con, row->trunc_int, 20);
+    writer_put_fixed_padded(con, row->trunc_real, 5, 20);
+    writer_put_int_padded(con, row->trunc_int, 20);
+    writer_put_char(con, '\n');
 }
 
 // Validate user inputs for correctness
-void validate_input(double m, double M, double sigma, int N) {
+void validate_input(double m, double M, double sigma, long long N) {
     if (m >= M) {
         fprintf(stderr, "Error: Minimum value (m) must be less than maximum value (M).\n");
         exit(EXIT_FAILURE);
@@ -263,4 +459,4 @@ void validate_input(double m, double M, double sigma, int N) {
         fprintf(stderr, "Error: Number of sequences (N) must be greater than zero.\n");
         exit(EXIT_FAILURE);
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,465 @@
+/******************************************************************************
+ * File: rngd.c
+ *
+ * Purpose:
+ * Long-running sample server, so that simulation workers stop running rns
+ * and parsing the DATA text files in their hot loops. Workers connect over
+ * a Unix domain socket with the client library (rngd_client.h), name a
+ * distribution and an engine stream, and then read binary samples from a
+ * shared memory ring that a server thread keeps full in the background.
+ * See rngd.h for the protocol and the ring.
+ *
+ * Every session owns its engine stream and its ring, so clients never
+ * contend with each other and a session's samples do not depend on what the
+ * other clients do. At most RNGD_MAX_SESSIONS sessions run at once and
+ * their rings share RNGD_RING_BUDGET bytes; a client over either limit is
+ * refused with a message, as for a bad request.
+ *
+ * Usage:
+ * - Compile: make rngd
+ * - Execute: ./rngd [-S socket] [-s seed]
+ *   -S is the socket path (default $RNGD_SOCKET, else /tmp/rngd.sock).
+ *   -s seeds the streams handed to clients that do not bring their own
+ *   (RNGD_OWN_SEED); without it the seed is taken from the clock and
+ *   printed. Session k of an engine kind then gets stream k of that seed.
+ *   SIGINT / SIGTERM remove the socket and stop the server.
+ *
+ *****************************************************************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "dataset.h"
+#include "dist.h"
+#include "engine.h"
+#include "instr.h"
+#include "normal.h"
+#include "rngd.h"
+
+typedef struct {
+    int fd;                 // Connected client socket
+    rngd_request_t req;
+} session_t;
+
+// Next stream of the server seed, per engine kind, for clients without their own
+static pthread_mutex_t streams_lock = PTHREAD_MUTEX_INITIALIZER;
+static rng_engine_t next_stream[2];
+static uint64_t next_stream_index[2];
+
+// Live sessions and the bytes of their rings (RNGD_MAX_SESSIONS, RNGD_RING_BUDGET)
+static pthread_mutex_t budget_lock = PTHREAD_MUTEX_INITIALIZER;
+static int live_sessions;
+static uint64_t ring_bytes;
+
+static volatile sig_atomic_t stopping;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+// Read exactly n bytes; -1 on error or end of file
+static int read_all(int fd, void *p, size_t n) {
+    char *s = p;
+    while (n > 0) {
+        ssize_t r = read(fd, s, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return -1;
+        }
+        s += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+// Send the reply, with the ring descriptor attached when ring_fd >= 0
+static int send_reply(int fd, const rngd_reply_t *reply, int ring_fd) {
+    struct iovec iov = {.iov_base = (void *)reply, .iov_len = sizeof *reply};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (ring_fd >= 0) {
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof ctl.buf;
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &ring_fd, sizeof(int));
+    }
+    ssize_t w;
+    do {
+        w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (w < 0 && errno == EINTR);
+    return w == (ssize_t)sizeof *reply ? 0 : -1;
+}
+
+static int refuse(int fd, const char *why) {
+    rngd_reply_t reply;
+    memset(&reply, 0, sizeof reply);
+    reply.status = -1;
+    snprintf(reply.error, sizeof(reply.error), "%s", why);
+    send_reply(fd, &reply, -1);
+    return -1;
+}
+
+// Check the request and set up its distribution and engine; -1 (reply sent) if unusable
+static int open_stream(int fd, const rngd_request_t *req, batch_dist_t *dist, rng_engine_t *eng,
+                       rngd_reply_t *reply) {
+    if (memcmp(req->magic, RNGD_MAGIC, sizeof(req->magic)) != 0 || req->version != RNGD_VERSION) {
+        return refuse(fd, "protocol version mismatch");
+    }
+    int type = (int)req->distribution;
+    if (dist_file_name(type) == NULL) {
+        return refuse(fd, "unknown distribution");
+    }
+    if (req->engine > ENGINE_PHILOX4X32 || req->normal_method > NORMAL_BOX_MULLER) {
+        return refuse(fd, "unknown engine or normal method");
+    }
+    if (type == DIST_UNIFORM_REAL || type == DIST_UNIFORM_INT ? !(req->m <= req->M) : !(req->sigma > 0)) {
+        return refuse(fd, "bad parameters (need m <= M, sigma > 0)");
+    }
+    if (dist_is_integer(type) && type != DIST_NORMAL_INT && (req->m < -2147483648.0 || req->M > 2147483647.0)) {
+        return refuse(fd, "integer range does not fit int32");
+    }
+    if (batch_dist_init(dist, (dist_type_t)type, req->m, req->M, req->mu, req->sigma) != 0) {
+        return refuse(fd, "empty truncation window");
+    }
+
+    engine_kind_t kind = (engine_kind_t)req->engine;
+    if (req->flags & RNGD_OWN_SEED) {
+        if (req->stream > RNGD_MAX_STREAM) {
+            return refuse(fd, "stream too large");
+        }
+        engine_init(eng, kind, req->seed);
+        for (uint64_t s = 0; s < req->stream; s++) {
+            engine_long_jump(eng);
+        }
+        reply->stream = req->stream;
+    } else {
+        pthread_mutex_lock(&streams_lock);
+        *eng = next_stream[kind];
+        reply->stream = next_stream_index[kind]++;
+        engine_long_jump(&next_stream[kind]);
+        pthread_mutex_unlock(&streams_lock);
+    }
+    eng->normal_method = (int)req->normal_method;
+    reply->seed = eng->seed;
+    return 0;
+}
+
+// Bytes of a ring: header plus capacity samples
+static size_t ring_size(uint64_t capacity, int type) {
+    return RNGD_RING_HEADER + (size_t)capacity * (dist_is_integer(type) ? sizeof(int32_t) : sizeof(double));
+}
+
+// Create the shared ring in a memfd; -1 on error
+static int create_ring(uint64_t capacity, int type, int *ring_fd, rngd_ring_t **ring, size_t *size) {
+    uint32_t elem_size = dist_is_integer(type) ? sizeof(int32_t) : sizeof(double);
+    *size = ring_size(capacity, type);
+    *ring_fd = memfd_create("rngd-ring", MFD_CLOEXEC);
+    if (*ring_fd < 0) {
+        return -1;
+    }
+    if (ftruncate(*ring_fd, (off_t)*size) != 0) {
+        close(*ring_fd);
+        return -1;
+    }
+    void *p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, *ring_fd, 0);
+    if (p == MAP_FAILED) {
+        close(*ring_fd);
+        return -1;
+    }
+    rngd_ring_t *r = p;
+    memcpy(r->magic, RNGD_RING_MAGIC, sizeof(r->magic));
+    r->version = RNGD_VERSION;
+    r->elem_type = dist_is_integer(type) ? DS_INT32 : DS_FLOAT64;
+    r->elem_size = elem_size;
+    r->distribution = (uint32_t)type;
+    r->capacity = capacity;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->producer_waiting, 0);
+    atomic_init(&r->consumer_waiting, 0);
+    *ring = r;
+    return 0;
+}
+
+// Charge a ring of size bytes to the server-wide budget; -1 if it would go over
+static int reserve_ring(size_t size) {
+    pthread_mutex_lock(&budget_lock);
+    int ok = ring_bytes + size <= RNGD_RING_BUDGET;
+    if (ok) {
+        ring_bytes += size;
+    }
+    pthread_mutex_unlock(&budget_lock);
+    return ok ? 0 : -1;
+}
+
+static void release_ring(size_t size) {
+    pthread_mutex_lock(&budget_lock);
+    ring_bytes -= size;
+    pthread_mutex_unlock(&budget_lock);
+}
+
+// Give back the session slot taken in accept_client
+static void end_session(void) {
+    pthread_mutex_lock(&budget_lock);
+    live_sessions--;
+    pthread_mutex_unlock(&budget_lock);
+}
+
+// Ring capacity for a request: a power of two, at least two blocks
+static uint64_t ring_capacity(uint64_t wanted) {
+    if (wanted == 0) {
+        wanted = RNGD_DEFAULT_CAPACITY;
+    }
+    if (wanted > RNGD_MAX_CAPACITY) {
+        wanted = RNGD_MAX_CAPACITY;
+    }
+    uint64_t c = 2 * RNGD_BLOCK;
+    while (c < wanted) {
+        c <<= 1;
+    }
+    return c;
+}
+
+// Wait until the client frees space, wakes us or goes away; 0 when it has gone
+static int wait_for_client(int fd) {
+    struct pollfd p = {.fd = fd, .events = POLLIN};
+    if (poll(&p, 1, -1) < 0) {
+        return errno == EINTR;
+    }
+    // Drain the wake-up bytes; end of file (or an error) ends the session
+    char buf[64];
+    ssize_t r = recv(fd, buf, sizeof buf, MSG_DONTWAIT);
+    return r > 0 || (r < 0 && (errno == EAGAIN || errno == EINTR));
+}
+
+// Whether the client has closed its socket (peeks, so wake-ups stay queued)
+static int client_gone(int fd) {
+    char c;
+    ssize_t r = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR);
+}
+
+// Keep the ring full until the client closes its socket
+static void produce(int fd, rngd_ring_t *r, const batch_dist_t *dist, rng_engine_t *eng) {
+    char *data = (char *)r + RNGD_RING_HEADER;
+    const uint64_t mask = r->capacity - 1;
+    const int integer = dist_is_integer(dist->type);
+    uint64_t head = 0;
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (r->capacity - (head - tail) < RNGD_BLOCK) {
+            // Full: say so, then look again before sleeping so a read in between is not missed
+            atomic_store(&r->producer_waiting, 1);
+            tail = atomic_load(&r->tail);
+            if (r->capacity - (head - tail) < RNGD_BLOCK) {
+                if (!wait_for_client(fd)) {
+                    return;
+                }
+            }
+            atomic_store(&r->producer_waiting, 0);
+            continue;
+        }
+        // head is a multiple of RNGD_BLOCK and the capacity a power of two, so a block never wraps
+        INSTR_TIME_START(t_gen);
+        if (integer) {
+            batch_dist_fill_int(dist, eng, (int *)(data + (head & mask) * sizeof(int32_t)), RNGD_BLOCK);
+        } else {
+            batch_dist_fill(dist, eng, (double *)(data + (head & mask) * sizeof(double)), RNGD_BLOCK);
+        }
+        INSTR_TIME_STOP(t_gen, INSTR_GENERATE);
+        head += RNGD_BLOCK;
+        atomic_store(&r->head, head);
+        // Filling a large ring takes a while: a client gone meanwhile hands its budget back early
+        if (head % (256 * RNGD_BLOCK) == 0 && client_gone(fd)) {
+            return;
+        }
+        if (atomic_load(&r->consumer_waiting) && atomic_exchange(&r->consumer_waiting, 0)) {
+            char wake = 1;
+            if (send(fd, &wake, 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN) {
+                return;
+            }
+        }
+    }
+}
+
+static void *session_main(void *arg) {
+    session_t *s = arg;
+    batch_dist_t dist;
+    rng_engine_t eng;
+    rngd_reply_t reply;
+    memset(&dist, 0, sizeof dist);
+    memset(&reply, 0, sizeof reply);
+    // The request is read here, so a slow client cannot hold up accept()
+    if (read_all(s->fd, &s->req, sizeof s->req) == 0 && open_stream(s->fd, &s->req, &dist, &eng, &reply) == 0) {
+        int ring_fd;
+        rngd_ring_t *ring;
+        size_t size;
+        reply.capacity = ring_capacity(s->req.capacity);
+        size = ring_size(reply.capacity, (int)s->req.distribution);
+        if (reserve_ring(size) != 0) {
+            refuse(s->fd, "ring memory budget exhausted (ask for a smaller capacity)");
+        } else if (create_ring(reply.capacity, (int)s->req.distribution, &ring_fd, &ring, &size) != 0) {
+            refuse(s->fd, "cannot create the shared ring");
+            release_ring(size);
+        } else {
+            reply.elem_type = ring->elem_type;
+            int sent = send_reply(s->fd, &reply, ring_fd);
+            close(ring_fd);
+            if (sent == 0) {
+                produce(s->fd, ring, &dist, &eng);
+            }
+            munmap(ring, size);
+            release_ring(size);
+        }
+    }
+    batch_dist_free(&dist); // Its alias table may now leave the cache
+    close(s->fd);
+    free(s);
+    end_session();
+    return NULL;
+}
+
+// Take one connection and hand it to a session thread
+static void accept_client(int listener) {
+    int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+            perror("accept");
+        }
+        return;
+    }
+    pthread_mutex_lock(&budget_lock);
+    int full = live_sessions >= RNGD_MAX_SESSIONS;
+    if (!full) {
+        live_sessions++;
+    }
+    pthread_mutex_unlock(&budget_lock);
+    if (full) {
+        refuse(fd, "too many sessions");
+        close(fd);
+        return;
+    }
+    session_t *s = malloc(sizeof *s);
+    if (s == NULL) {
+        refuse(fd, "out of memory");
+        close(fd);
+        end_session();
+        return;
+    }
+    s->fd = fd;
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // Sessions inherit the blocked SIGINT / SIGTERM of the main thread
+    if (pthread_create(&thread, &attr, session_main, s) != 0) {
+        refuse(fd, "cannot start a session");
+        close(fd);
+        free(s);
+        end_session();
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int main(int argc, char *argv[]) {
+    INSTR_BEGIN(argc, argv);
+    uint64_t seed = (uint64_t)time(NULL); // Default: seed from the current time
+    const char *path = getenv("RNGD_SOCKET");
+    if (path == NULL || *path == '\0') {
+        path = RNGD_DEFAULT_SOCKET;
+    }
+    int opt;
+    while ((opt = getopt(argc, argv, "S:s:")) != -1) {
+        switch (opt) {
+        case 'S':
+            path = optarg;
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-S socket] [-s seed]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+    // Non-blocking: a connection that is gone by the time of accept() must not block it
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listener < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(listener, 64) != 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    engine_init(&next_stream[ENGINE_XOSHIRO256PP], ENGINE_XOSHIRO256PP, seed);
+    engine_init(&next_stream[ENGINE_PHILOX4X32], ENGINE_PHILOX4X32, seed);
+
+    // SIGINT / SIGTERM stay blocked except inside ppoll(), which unblocks
+    // them atomically: one arriving between the stopping check and the wait
+    // is delivered as soon as the wait starts, so it cannot be lost
+    sigset_t stop, waiting;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, &waiting);
+    sigdelset(&waiting, SIGINT);
+    sigdelset(&waiting, SIGTERM);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Serving on %s, seed: %llu\n", path, (unsigned long long)seed);
+    fflush(stdout);
+    struct pollfd pfd = {.fd = listener, .events = POLLIN};
+    while (!stopping) {
+        if (ppoll(&pfd, 1, NULL, &waiting) > 0) {
+            accept_client(listener);
+        } else if (errno != EINTR) {
+            perror("poll");
+            break;
+        }
+    }
+    close(listener);
+    unlink(path);
+    INSTR_REPORT();
+    return EXIT_SUCCESS;
+}
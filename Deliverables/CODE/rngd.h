@@ -0,0 +1,101 @@
+/******************************************************************************
+ * File: rngd.h
+ *
+ * Purpose:
+ * Wire protocol and shared ring layout of the rngd sample server (rngd.c)
+ * and its client library (rngd_client.h).
+ *
+ * A client connects to the server's Unix domain socket and sends one
+ * rngd_request_t naming a distribution, its parameters and an engine
+ * stream. The server answers with an rngd_reply_t and, on success, passes
+ * the descriptor of a shared memory ring (memfd, SCM_RIGHTS) which the
+ * client maps. From then on:
+ *
+ * - A server thread owned by the session keeps the ring full, in blocks of
+ *   RNGD_BLOCK samples drawn with batch_dist_fill / batch_dist_fill_int.
+ * - The client takes samples straight out of the mapping: single producer,
+ *   single consumer, head and tail are atomics, so a read is a memcpy.
+ * - The socket only carries one-byte wake-ups, sent when the other side has
+ *   said (through a *_waiting flag) that it is about to sleep: the client
+ *   when the ring is empty, the server when it is full. Closing the socket
+ *   ends the session.
+ *
+ * Samples are float64 for the real types and int32 for the integer types,
+ * as in the .bin datasets (dataset.h). The samples of a session depend only
+ * on (engine, normal method, seed, stream, distribution, parameters), so a
+ * worker can be rerun exactly: stream s is the engine seeded with seed after
+ * s long jumps, as for the files of an rns run.
+ *
+ *****************************************************************************/
+#ifndef RNGD_H
+#define RNGD_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define RNGD_MAGIC "RNGD001"
+#define RNGD_RING_MAGIC "RNGRING"
+#define RNGD_VERSION 1
+// Socket used when neither the command line nor RNGD_SOCKET names one
+#define RNGD_DEFAULT_SOCKET "/tmp/rngd.sock"
+// Samples produced per fill; ring capacities are multiples of it
+#define RNGD_BLOCK 4096
+// Default and largest ring capacity, in samples
+#define RNGD_DEFAULT_CAPACITY (1 << 20)
+#define RNGD_MAX_CAPACITY (1 << 26)
+// Offset of the first sample in the ring mapping
+#define RNGD_RING_HEADER 256
+// Explicit streams above this are refused (xoshiro long jumps are O(stream))
+#define RNGD_MAX_STREAM (1 << 20)
+// Sessions served at once; more are refused, which also bounds the long
+// jumps of explicit streams running at any time
+#define RNGD_MAX_SESSIONS 256
+// Bytes all rings together may take; a ring that would go over is refused
+#define RNGD_RING_BUDGET ((uint64_t)2 << 30)
+
+// rngd_request_t.flags: use the request's seed and stream; otherwise the
+// server hands out the next stream of its own seed (reported in the reply)
+#define RNGD_OWN_SEED 1u
+
+typedef struct {
+    char magic[8];          // RNGD_MAGIC
+    uint32_t version;       // RNGD_VERSION
+    uint32_t flags;
+    uint32_t distribution;  // dist_type_t
+    uint32_t engine;        // engine_kind_t
+    uint32_t normal_method; // normal_method_t
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t stream;
+    uint64_t capacity;      // Ring samples wanted, 0 for the default
+    double mu, sigma, m, M;
+} rngd_request_t;
+
+typedef struct {
+    int32_t status;         // 0, or -1 with a message in error
+    uint32_t elem_type;     // ds_elem_t
+    uint64_t capacity;      // Ring capacity actually used
+    uint64_t seed;          // Stream served, for reproducing the session
+    uint64_t stream;
+    char error[96];
+} rngd_reply_t;
+
+// Start of the shared mapping; the samples follow at RNGD_RING_HEADER.
+// head is written by the server only and tail by the client only, each on
+// its own cache line.
+typedef struct {
+    char magic[8];          // RNGD_RING_MAGIC
+    uint32_t version;
+    uint32_t elem_type;
+    uint32_t elem_size;
+    uint32_t distribution;
+    uint64_t capacity;      // Samples; a power of two
+    _Alignas(64) _Atomic uint64_t head;     // Samples produced
+    _Atomic uint32_t producer_waiting;      // Server asleep on a full ring
+    _Alignas(64) _Atomic uint64_t tail;     // Samples consumed
+    _Atomic uint32_t consumer_waiting;      // Client asleep on an empty ring
+} rngd_ring_t;
+
+_Static_assert(sizeof(rngd_ring_t) <= RNGD_RING_HEADER, "ring header too large");
+
+#endif
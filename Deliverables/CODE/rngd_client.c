@@ -0,0 +1,212 @@
+/******************************************************************************
+ * File: rngd_client.c
+ *
+ * Purpose:
+ * Session set-up (socket, request, ring descriptor) and the ring consumer
+ * for rngd_client.h.
+ *
+ *****************************************************************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "engine.h"
+#include "normal.h"
+#include "rngd_client.h"
+
+// Samples widened per step by rngd_read_double
+#define CLIENT_WIDEN 1024
+
+void rngd_request_init(rngd_request_t *req, dist_type_t type, double m, double M, double mu, double sigma) {
+    memset(req, 0, sizeof *req);
+    memcpy(req->magic, RNGD_MAGIC, sizeof(req->magic));
+    req->version = RNGD_VERSION;
+    req->distribution = (uint32_t)type;
+    req->engine = ENGINE_XOSHIRO256PP;
+    req->normal_method = NORMAL_ZIGGURAT;
+    req->m = m;
+    req->M = M;
+    req->mu = mu;
+    req->sigma = sigma;
+}
+
+// Receive the reply and the ring descriptor that comes with it (-1 if none)
+static int recv_reply(int fd, rngd_reply_t *reply, int *ring_fd) {
+    struct iovec iov = {.iov_base = reply, .iov_len = sizeof *reply};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof ctl.buf;
+    ssize_t r;
+    do {
+        r = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (r < 0 && errno == EINTR);
+    *ring_fd = -1;
+    if (r < 0) {
+        return -1; // Nothing was received: the control buffer is not filled in
+    }
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (c != NULL && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS &&
+        c->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(ring_fd, CMSG_DATA(c), sizeof(int));
+    }
+    // A truncated control message may have lost descriptors: refuse the reply
+    return r == (ssize_t)sizeof *reply && !(msg.msg_flags & MSG_CTRUNC) ? 0 : -1;
+}
+
+static int fail(rngd_client_t *c, char *err, size_t errlen, const char *what) {
+    snprintf(err, errlen, "%s", what);
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    return -1;
+}
+
+int rngd_connect(rngd_client_t *c, const char *path, const rngd_request_t *req, char *err, size_t errlen) {
+    memset(c, 0, sizeof *c);
+    c->fd = -1;
+    if (path == NULL) {
+        path = getenv("RNGD_SOCKET");
+        if (path == NULL || *path == '\0') {
+            path = RNGD_DEFAULT_SOCKET;
+        }
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return fail(c, err, errlen, "socket path too long");
+    }
+    strcpy(addr.sun_path, path);
+    c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+        return fail(c, err, errlen, strerror(errno));
+    }
+    // A server that is full refuses before reading the request, so even if the
+    // send fails its reply may be waiting
+    int sent = send(c->fd, req, sizeof *req, MSG_NOSIGNAL) == (ssize_t)sizeof *req;
+
+    rngd_reply_t reply;
+    int ring_fd;
+    int got = recv_reply(c->fd, &reply, &ring_fd) == 0;
+    if (!got || reply.status != 0 || ring_fd < 0) {
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+        reply.error[sizeof(reply.error) - 1] = '\0';
+        const char *why = sent ? "no reply from the server" : "cannot send the request";
+        return fail(c, err, errlen, got && reply.status != 0 ? reply.error : why);
+    }
+    uint32_t elem_size = reply.elem_type == DS_INT32 ? sizeof(int32_t) : sizeof(double);
+    c->map_size = RNGD_RING_HEADER + (size_t)reply.capacity * elem_size;
+    void *p = mmap(NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+    close(ring_fd);
+    if (p == MAP_FAILED) {
+        return fail(c, err, errlen, strerror(errno));
+    }
+    c->ring = p;
+    if (memcmp(c->ring->magic, RNGD_RING_MAGIC, sizeof(c->ring->magic)) != 0 || c->ring->capacity != reply.capacity) {
+        munmap(p, c->map_size);
+        c->ring = NULL;
+        return fail(c, err, errlen, "bad ring header");
+    }
+    c->data = (const char *)p + RNGD_RING_HEADER;
+    c->mask = reply.capacity - 1;
+    c->elem_size = elem_size;
+    c->integer = reply.elem_type == DS_INT32;
+    c->seed = reply.seed;
+    c->stream = reply.stream;
+    return 0;
+}
+
+// Sleep until the server has produced past our tail; -1 if it has gone
+static int wait_for_server(rngd_client_t *c) {
+    rngd_ring_t *r = c->ring;
+    // Say so, then look again before sleeping so a block published in between is not missed
+    atomic_store(&r->consumer_waiting, 1);
+    if (atomic_load(&r->head) != c->tail) {
+        atomic_store(&r->consumer_waiting, 0);
+        return 0;
+    }
+    char wake;
+    ssize_t n;
+    do {
+        n = recv(c->fd, &wake, 1, 0);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 ? 0 : -1;
+}
+
+int rngd_read(rngd_client_t *c, void *out, size_t n) {
+    rngd_ring_t *r = c->ring;
+    char *dst = out;
+    while (n > 0) {
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (head == c->tail) {
+            if (wait_for_server(c) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        // Up to the end of what is there, and of the ring
+        uint64_t pos = c->tail & c->mask;
+        uint64_t len = head - c->tail;
+        len = len < n ? len : n;
+        len = len < c->mask + 1 - pos ? len : c->mask + 1 - pos;
+        memcpy(dst, c->data + pos * c->elem_size, (size_t)len * c->elem_size);
+        dst += len * c->elem_size;
+        n -= (size_t)len;
+        c->tail += len;
+        atomic_store(&r->tail, c->tail);
+        if (atomic_load(&r->producer_waiting) && atomic_exchange(&r->producer_waiting, 0)) {
+            char wake = 1;
+            send(c->fd, &wake, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+    }
+    return 0;
+}
+
+int rngd_read_double(rngd_client_t *c, double *out, size_t n) {
+    if (!c->integer) {
+        return rngd_read(c, out, n);
+    }
+    int32_t v[CLIENT_WIDEN];
+    for (size_t done = 0; done < n; done += CLIENT_WIDEN) {
+        size_t len = n - done < CLIENT_WIDEN ? n - done : CLIENT_WIDEN;
+        if (rngd_read(c, v, len) != 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < len; i++) {
+            out[done + i] = v[i];
+        }
+    }
+    return 0;
+}
+
+int rngd_read_int(rngd_client_t *c, int32_t *out, size_t n) {
+    return c->integer ? rngd_read(c, out, n) : -1;
+}
+
+void rngd_close(rngd_client_t *c) {
+    if (c->ring != NULL) {
+        munmap(c->ring, c->map_size);
+        c->ring = NULL;
+    }
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
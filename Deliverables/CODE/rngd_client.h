@@ -0,0 +1,61 @@
+/******************************************************************************
+ * File: rngd_client.h
+ *
+ * Purpose:
+ * Client library of the rngd sample server (rngd.c). A worker opens one
+ * session per distribution it needs and then reads samples in whatever
+ * amounts suit it; a read copies out of a shared memory ring the server
+ * keeps full, so it costs a memcpy and only waits when the worker consumes
+ * faster than the server generates.
+ *
+ * Usage:
+ *   rngd_request_t req;
+ *   rngd_request_init(&req, DIST_TRUNC_REAL, 0, 100, 50, 12);
+ *   rngd_client_t c;
+ *   if (rngd_connect(&c, NULL, &req, err, sizeof err) != 0) ...
+ *   rngd_read_double(&c, out, n);
+ *   rngd_close(&c);
+ *
+ * A session is used by one thread at a time (the ring has a single
+ * consumer); threads that need samples open their own sessions. Link with
+ * librngd_client.a (make librngd_client.a): it needs nothing else from this
+ * folder.
+ *
+ *****************************************************************************/
+#ifndef RNGD_CLIENT_H
+#define RNGD_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dist.h"
+#include "rngd.h"
+
+typedef struct {
+    int fd;                 // Session socket
+    rngd_ring_t *ring;
+    const char *data;       // First sample of the ring
+    size_t map_size;
+    uint64_t mask;          // capacity - 1
+    uint64_t tail;          // Samples consumed (our copy of ring->tail)
+    uint32_t elem_size;     // 8 (float64) or 4 (int32)
+    int integer;            // Integer distribution: samples are int32
+    uint64_t seed, stream;  // Stream being served (for reproducing the session)
+} rngd_client_t;
+
+// Request a type with parameters (as in gen_file_t), xoshiro, ziggurat and
+// a stream assigned by the server; set flags, seed, stream etc. afterwards
+void rngd_request_init(rngd_request_t *req, dist_type_t type, double m, double M, double mu, double sigma);
+// Connect to the server at path (NULL: $RNGD_SOCKET, else RNGD_DEFAULT_SOCKET)
+// and open a session; -1 with a message in err on failure
+int rngd_connect(rngd_client_t *c, const char *path, const rngd_request_t *req, char *err, size_t errlen);
+// Copy the next n samples (elem_size bytes each) to out; -1 if the server has gone
+int rngd_read(rngd_client_t *c, void *out, size_t n);
+// Next n samples as doubles (integer samples are widened); -1 if the server has gone
+int rngd_read_double(rngd_client_t *c, double *out, size_t n);
+// Next n samples of an integer distribution; -1 if not integer or the server has gone
+int rngd_read_int(rngd_client_t *c, int32_t *out, size_t n);
+// End the session
+void rngd_close(rngd_client_t *c);
+
+#endif
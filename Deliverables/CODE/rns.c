@@ -2,9 +2,54 @@
  * ========================================================================================
  * Usage:
  * In terminal type "make". Then after use "/.rns" to run this portion of the code. 
+ * - Options: ./rns [-s seed] [-e xoshiro|philox] [-n ziggurat|boxmuller] [-j threads] [-f txt|bin|both]
+ *   [-q sequence] [-p] [-c] [-i spec]
+ *   Each output file draws from its own long-jump stream of the seeded engine and
+ *   is generated in chunks on jump-ahead substreams, so the files are identical for
+ *   a given seed whatever the -j value (default: all online CPUs).
+ *   -f bin/both writes <name>.bin datasets (see dataset.h) that can be mmap()ed
+ *   directly; dsconv converts between the two layouts.
+ * - -i spec runs the jobs listed in a spec file instead of Scenario1-3, all in
+ *   this one process and on one shared thread pool. One job per line:
+ *       <folder> <types> <mu> <sigma> <m> <M> <N> [seed] [sequence]
+ *   types is "all" or a comma list of type names/numbers (see dist.h), e.g.
+ *       DATA/Sweep/s10 normal_real,truncated_normal_real 100 10 60 140 1000000 7
+ *   '#' starts a comment. A job without a seed (or with "-") takes the next
+ *   streams of the -s seed, so the default table is the spec
+ *       DATA/Scenario1 all 5 1 1 8 20
+ *       DATA/Scenario2 all 1024 256 1 2000 200000
+ *       DATA/Scenario3 all 4096 1331.2 1 8100 2000000
+ *   Every file is written by one job only: a spec that lists a type twice
+ *   for the same folder is rejected, and so, with -p, are two folders with
+ *   the same last component (both would write HISTOGRAM/<that component>).
+ *   The time taken by every job is printed at the end.
+ * - -q sobol|sobol-owen|halton|halton-scrambled draws the files from a
+ *   quasi-random sequence instead of the engine (qmc.h): the histograms and
+ *   moments then reach a given accuracy with one to two orders of magnitude
+ *   fewer samples. The d-th file of a job uses coordinate d; the scrambled
+ *   sequences are scrambled from the file's stream, so they still change
+ *   with the seed. A spec line picks its own with the [sequence] field
+ *   ("prng" for the engine; give the seed as "-" to keep the -s streams).
+ * - -p (pipeline) also folds every generated block into running moments, a
+ *   histogram, a KLL quantile sketch and a goodness-of-fit table against the
+ *   file's own distribution in the same pass, then writes statistics.txt
+ *   (moments, min/max, quantiles, Kolmogorov-Smirnov and chi-square with
+ *   p-values) and HISTOGRAM/ScenarioN/<name>_histogram.txt (HISTOGRAM_BINS
+ *   bins) without reading the data files back.
+ * - -c keeps a checkpoint record <folder>/<name>.ckpt next to every file
+ *   (genpool.h) and uses the ones already there: a file that is complete for
+ *   the same distribution, parameters, engine, stream, sequence, formats and
+ *   N is skipped; an interrupted one resumes after its last checkpoint
+ *   (every GEN_CKPT_CHUNKS chunks); and a larger N in a spec line extends a
+ *   file by appending. The output is always the same bytes as a fresh run.
+ *   The records are keyed on the seed, so use -s: the default seed is the
+ *   time. The "Reused" column gives the samples taken from earlier runs.
+ * - Built with make INSTRUMENT=1, every run also writes rns_report.json:
+ *   stage times, samples, rejection rates, bytes and flush latencies (instr.h).
  * - I used "r" because it is shorter to call in the executable but you can easily change it.
  */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
@@ -12,96 +57,616 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "normal.h"
+#include "genpool.h"
+#include "gof.h"
+#include "hist.h"
+#include "instr.h"
+#include "kll.h"
+#include "qmc.h"
+#include "stats.h"
+#include "writer.h"
 
-#define frand() (rand() / (double)RAND_MAX)
-#define nrand() (sqrt(-2 * log(frand())) * cos(2 * M_PI * frand()))
 #define HISTOGRAM_BINS 50
+#define FILES_PER_SCENARIO 6
+
+// One line of a spec file: a set of distributions sharing parameters and folder
+typedef struct
+{
+    char folder[200];
+    int types[DIST_COUNT];
+    int ntypes;
+    double mu, sigma, m, M;
+    int64_t N;
+    int has_seed;       // Otherwise the job continues the streams of the -s seed
+    uint64_t seed;
+    int sequence;       // qmc_kind_t, or -1 for the -q sequence
+    int first_file;     // Index of the job's first file in the run
+} job_t;
 
-void generate_random_numbers_to_file(const char *filename, int type, double m, double M, double mu, double sigma, int N);
 int create_directory(const char *path);
+int load_jobs(const char *path, job_t **jobs);
+int default_jobs(job_t **jobs);
+void histogram_range(const gen_file_t *f, double *lo, double *hi);
+const char *histogram_folder(const char *folder);
+int check_histogram_folders(const job_t *jobs, int njobs);
+int write_pipeline_results(const gen_file_t *files, const job_t *jobs, int njobs);
+void report_job_times(const gen_file_t *files, const job_t *jobs, int njobs, int checkpoint);
 
-int main()
+int main(int argc, char *argv[])
+{
+    INSTR_BEGIN(argc, argv);
+    uint64_t seed = (uint64_t)time(NULL);
+    engine_kind_t kind = ENGINE_XOSHIRO256PP;
+    normal_method_t method = NORMAL_ZIGGURAT;
+    int threads = genpool_default_threads();
+    int formats = GEN_OUT_TEXT;
+    int pipeline = 0;
+    int checkpoint = 0;
+    qmc_kind_t sequence = QMC_NONE;
+    const char *spec = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:e:n:j:f:q:pci:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            if (engine_kind_from_name(optarg) < 0)
+            {
+                fprintf(stderr, "Unknown engine '%s' (use xoshiro or philox)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            kind = (engine_kind_t)engine_kind_from_name(optarg);
+            break;
+        case 'n':
+            if (normal_method_from_name(optarg) < 0)
+            {
+                fprintf(stderr, "Unknown normal method '%s' (use ziggurat or boxmuller)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            method = (normal_method_t)normal_method_from_name(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "txt") == 0)
+                formats = GEN_OUT_TEXT;
+            else if (strcmp(optarg, "bin") == 0)
+                formats = GEN_OUT_BINARY;
+            else if (strcmp(optarg, "both") == 0)
+                formats = GEN_OUT_TEXT | GEN_OUT_BINARY;
+            else
+            {
+                fprintf(stderr, "Unknown format '%s' (use txt, bin or both)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'q':
+            if (qmc_kind_from_name(optarg) < 0)
+            {
+                fprintf(stderr, "Unknown sequence '%s' (use prng, sobol, sobol-owen, halton or halton-scrambled)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            sequence = (qmc_kind_t)qmc_kind_from_name(optarg);
+            break;
+        case 'p':
+            pipeline = 1;
+            break;
+        case 'c':
+            checkpoint = 1;
+            break;
+        case 'i':
+            spec = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s seed] [-e xoshiro|philox] [-n ziggurat|boxmuller] [-j threads] [-f txt|bin|both] [-q sequence] [-p] [-c] [-i spec]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    printf("Engine: %s, normal: %s, seed: %llu\n", engine_kind_name(kind), normal_method_name(method),
+           (unsigned long long)seed);
+    if (sequence != QMC_NONE)
+    {
+        printf("Sequence: %s\n", qmc_kind_name(sequence));
+    }
+
+    job_t *jobs;
+    int njobs = spec != NULL ? load_jobs(spec, &jobs) : default_jobs(&jobs);
+    if (njobs < 0 || (pipeline && check_histogram_folders(jobs, njobs) != 0))
+    {
+        return EXIT_FAILURE;
+    }
+    int nfiles = 0;
+    for (int k = 0; k < njobs; k++)
+    {
+        jobs[k].first_file = nfiles;
+        nfiles += jobs[k].ntypes;
+    }
+    gen_file_t *files = calloc((size_t)nfiles + 1, sizeof(gen_file_t));
+    stats_acc_t *stats = calloc((size_t)nfiles + 1, sizeof(stats_acc_t));
+    hist_t *hists = calloc((size_t)nfiles + 1, sizeof(hist_t));
+    kll_t *sketches = calloc((size_t)nfiles + 1, sizeof(kll_t));
+    gof_t *gofs = calloc((size_t)nfiles + 1, sizeof(gof_t));
+    if (files == NULL || stats == NULL || hists == NULL || sketches == NULL || gofs == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Every file gets its own stream: file f starts f long jumps after the root.
+    // Jobs with their own seed number their streams from that seed instead.
+    rng_engine_t stream;
+    uint32_t next_stream = 0;
+    engine_init(&stream, kind, seed);
+    stream.normal_method = method;
+
+    for (int k = 0; k < njobs; k++)
+    {
+        job_t *job = &jobs[k];
+        rng_engine_t own;
+        uint32_t own_stream = 0;
+        if (job->has_seed)
+        {
+            engine_init(&own, kind, job->seed);
+            own.normal_method = method;
+        }
+        if (create_directory(job->folder) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        for (int d = 0; d < job->ntypes; d++)
+        {
+            gen_file_t *f = &files[job->first_file + d];
+            f->type = (dist_type_t)job->types[d];
+            snprintf(f->path, sizeof(f->path), "%s/%s.txt", job->folder, dist_file_name(f->type));
+            snprintf(f->bin_path, sizeof(f->bin_path), "%s/%s.bin", job->folder, dist_file_name(f->type));
+            if (checkpoint)
+            {
+                snprintf(f->ckpt_path, sizeof(f->ckpt_path), "%s/%s.ckpt", job->folder, dist_file_name(f->type));
+            }
+            f->formats = formats;
+            f->mu = job->mu;
+            f->sigma = job->sigma;
+            f->m = job->m;
+            f->M = job->M;
+            f->N = job->N;
+            f->sequence = job->sequence >= 0 ? (qmc_kind_t)job->sequence : sequence;
+            f->dimension = f->sequence != QMC_NONE ? (uint32_t)d : 0;
+            if (job->has_seed)
+            {
+                f->stream = own_stream++;
+                f->base = own;
+                engine_long_jump(&own);
+            }
+            else
+            {
+                f->stream = next_stream++;
+                f->base = stream;
+                engine_long_jump(&stream);
+            }
+            f->stats = NULL;
+            f->hist = NULL;
+            f->sketch = NULL;
+            f->gof = NULL;
+            if (pipeline)
+            {
+                int i = job->first_file + d;
+                double lo, hi;
+                histogram_range(f, &lo, &hi);
+                if (hist_init(&hists[i], HISTOGRAM_BINS, lo, hi, HIST_CLAMP) != 0)
+                {
+                    fprintf(stderr, "Out of memory\n");
+                    return EXIT_FAILURE;
+                }
+                stats_init(&stats[i]);
+                kll_init(&sketches[i], KLL_K);
+                f->stats = &stats[i];
+                f->hist = &hists[i];
+                f->sketch = &sketches[i];
+                // No test when the parameters leave no target to test against
+                if (gof_init(&gofs[i], f->type, f->m, f->M, f->mu, f->sigma, 0) == 0)
+                {
+                    f->gof = &gofs[i];
+                }
+            }
+        }
+    }
+
+    // All files of all jobs share one pool, so small jobs never leave cores idle
+    // and no thread or buffer is set up more than once
+    if (genpool_run(files, nfiles, threads) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    report_job_times(files, jobs, njobs, checkpoint);
+    int rc = 0;
+    if (pipeline)
+    {
+        rc = write_pipeline_results(files, jobs, njobs);
+        for (int i = 0; i < nfiles; i++)
+        {
+            hist_free(&hists[i]);
+            kll_free(&sketches[i]);
+            gof_free(&gofs[i]);
+        }
+    }
+    free(files);
+    free(stats);
+    free(hists);
+    free(sketches);
+    free(gofs);
+    free(jobs);
+    INSTR_REPORT();
+    return rc == 0 ? 0 : EXIT_FAILURE;
+}
+
+// The built-in Scenario1-3 table
+int default_jobs(job_t **jobs)
 {
-    srand(time(NULL));
     double scenarios[3][5] = {
         {5, 1, 1, 8, 20},
         {pow(2, 10), pow(2, 8), 1, 2000, 200000},
         {pow(2, 12), 1.3 * pow(2, 10), 1, 8100, 2000000}};
     char *subfolders[3] = {"DATA/Scenario1", "DATA/Scenario2", "DATA/Scenario3"};
-    create_directory("DATA");
-
+    *jobs = calloc(3, sizeof(job_t));
+    if (*jobs == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
     for (int i = 0; i < 3; i++)
     {
-        double mu = scenarios[i][0];
-        double sigma = scenarios[i][1];
-        double m = scenarios[i][2];
-        double M = scenarios[i][3];
-        int N = (int)scenarios[i][4];
-
-        create_directory(subfolders[i]);
+        job_t *job = &(*jobs)[i];
+        snprintf(job->folder, sizeof(job->folder), "%s", subfolders[i]);
+        job->ntypes = FILES_PER_SCENARIO;
+        for (int d = 0; d < FILES_PER_SCENARIO; d++)
+        {
+            job->types[d] = d + 1; // Types 1..6 in data file order
+        }
+        job->mu = scenarios[i][0];
+        job->sigma = scenarios[i][1];
+        job->m = scenarios[i][2];
+        job->M = scenarios[i][3];
+        job->N = (int64_t)scenarios[i][4];
+        job->sequence = -1;
+    }
+    return 3;
+}
 
-        char filepath[100];
-        snprintf(filepath, sizeof(filepath), "%s/uniform_integers.txt", subfolders[i]);
-        generate_random_numbers_to_file(filepath, 1, m, M, mu, sigma, N);
+// Parse "all" or a comma list of type names/numbers into job->types
+static int parse_types(job_t *job, char *list)
+{
+    job->ntypes = 0;
+    if (strcmp(list, "all") == 0)
+    {
+        for (int t = 1; t <= DIST_COUNT; t++)
+        {
+            job->types[job->ntypes++] = t;
+        }
+        return 0;
+    }
+    for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ","))
+    {
+        int t = dist_type_from_name(tok);
+        if (t < 0 || job->ntypes == DIST_COUNT)
+        {
+            return -1;
+        }
+        job->types[job->ntypes++] = t;
+    }
+    return job->ntypes > 0 ? 0 : -1;
+}
 
-        snprintf(filepath, sizeof(filepath), "%s/uniform_real.txt", subfolders[i]);
-        generate_random_numbers_to_file(filepath, 2, m, M, mu, sigma, N);
+// Index in jobs[0 .. n - 1] (or job itself) of a file the job would also write; -1 if none
+static int find_duplicate(const job_t *jobs, int n, const job_t *job, int *type)
+{
+    for (int d = 0; d < job->ntypes; d++)
+    {
+        *type = job->types[d];
+        for (int e = 0; e < d; e++)
+        {
+            if (job->types[e] == *type)
+            {
+                return n;
+            }
+        }
+        for (int k = 0; k < n; k++)
+        {
+            for (int e = 0; strcmp(jobs[k].folder, job->folder) == 0 && e < jobs[k].ntypes; e++)
+            {
+                if (jobs[k].types[e] == *type)
+                {
+                    return k;
+                }
+            }
+        }
+    }
+    return -1;
+}
 
-        snprintf(filepath, sizeof(filepath), "%s/normal_real.txt", subfolders[i]);
-        generate_random_numbers_to_file(filepath, 3, m, M, mu, sigma, N);
+// Read a spec file (format at the top of this file); returns the number of jobs or -1
+int load_jobs(const char *path, job_t **jobs)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    int n = 0, cap = 16, lineno = 0;
+    char line[1024];
+    *jobs = malloc((size_t)cap * sizeof(job_t));
+    while (*jobs != NULL && fgets(line, sizeof(line), in) != NULL)
+    {
+        char types[256], seed[64] = "-", seq[32] = "";
+        long long N;
+        job_t job;
+        lineno++;
+        line[strcspn(line, "#\n")] = '\0';
+        memset(&job, 0, sizeof job);
+        int fields = sscanf(line, "%199s %255s %lf %lf %lf %lf %lld %63s %31s", job.folder, types, &job.mu,
+                            &job.sigma, &job.m, &job.M, &N, seed, seq);
+        if (fields <= 0)
+        {
+            continue; // Blank or comment line
+        }
+        job.sequence = seq[0] != '\0' ? qmc_kind_from_name(seq) : -1;
+        // The seed is "-" or a whole number: anything else (a sequence name in
+        // its place, say) would silently become seed 0
+        char *end = seed;
+        if (strcmp(seed, "-") != 0)
+        {
+            errno = 0;
+            job.has_seed = 1;
+            job.seed = strtoull(seed, &end, 10);
+        }
+        int bad_seed = job.has_seed && (!isdigit((unsigned char)seed[0]) || *end != '\0' || errno == ERANGE);
+        if (fields < 7 || parse_types(&job, types) != 0 || N < 0 || bad_seed || !isfinite(job.mu) ||
+            !isfinite(job.sigma) || !isfinite(job.m) || !isfinite(job.M) || job.sigma <= 0 || job.m > job.M ||
+            (seq[0] != '\0' && job.sequence < 0))
+        {
+            fprintf(stderr, "%s:%d: expected <folder> <types> <mu> <sigma> <m> <M> <N> [seed] [sequence]\n", path, lineno);
+            fclose(in);
+            free(*jobs);
+            return -1;
+        }
+        // No two jobs may write the same file ("D/a/" is "D/a")
+        size_t len = strlen(job.folder);
+        while (len > 1 && job.folder[len - 1] == '/')
+        {
+            job.folder[--len] = '\0';
+        }
+        int type, dup = find_duplicate(*jobs, n, &job, &type);
+        if (dup >= 0)
+        {
+            fprintf(stderr, "%s:%d: %s/%s is already generated by %s\n", path, lineno, job.folder,
+                    dist_file_name(type), dup == n ? "this line" : "an earlier line");
+            fclose(in);
+            free(*jobs);
+            return -1;
+        }
+        job.N = N;
+        if (n == cap)
+        {
+            cap *= 2;
+            job_t *grown = realloc(*jobs, (size_t)cap * sizeof(job_t));
+            if (grown == NULL)
+            {
+                free(*jobs);
+                *jobs = NULL;
+                break;
+            }
+            *jobs = grown;
+        }
+        (*jobs)[n++] = job;
+    }
+    fclose(in);
+    if (*jobs == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    return n;
+}
 
-        snprintf(filepath, sizeof(filepath), "%s/normal_integer.txt",subfolders[i]);
-        generate_random_numbers_to_file(filepath, 1, m, M, mu, sigma, N);
-        
-        snprintf(filepath, sizeof(filepath), "%s/truncated_normal_real.txt", subfolders[i]);
-        generate_random_numbers_to_file(filepath, 3, m, M, mu, sigma, N);
-        
-        snprintf(filepath, sizeof(filepath), "%s/truncated_normal_integer.txt", subfolders[i]);
-        generate_random_numbers_to_file(filepath, 2, m, M, mu, sigma, N);
+// Wall time of every job: from its first chunk taken to its last chunk written
+void report_job_times(const gen_file_t *files, const job_t *jobs, int njobs, int checkpoint)
+{
+    printf("%-5s%-36s%8s%14s%12s%16s", "Job", "Folder", "Files", "Samples", "Seconds", "Samples/s");
+    printf(checkpoint ? "%14s\n" : "\n", "Reused");
+    for (int k = 0; k < njobs; k++)
+    {
+        const job_t *job = &jobs[k];
+        double start = 0, end = 0;
+        long long reused = 0;
+        for (int d = 0; d < job->ntypes; d++)
+        {
+            const gen_file_t *f = &files[job->first_file + d];
+            start = d == 0 || f->started < start ? f->started : start;
+            end = d == 0 || f->finished > end ? f->finished : end;
+            reused += f->kept;
+        }
+        double seconds = end - start;
+        long long samples = (long long)job->N * job->ntypes;
+        // The rate counts the samples this run wrote
+        printf("%-5d%-36s%8d%14lld%12.4f%16.0f", k + 1, job->folder, job->ntypes, samples, seconds,
+               seconds > 0 ? (samples - reused) / seconds : 0.0);
+        printf(checkpoint ? "%14lld\n" : "\n", reused);
     }
-    return 0;
 }
 
-int create_directory(const char *path)
+// Histogram window of a file: [m, M] for bounded distributions, mu +/- 4 sigma for
+// normals; integer windows are widened by half a unit at each end
+void histogram_range(const gen_file_t *f, double *lo, double *hi)
 {
-    if (mkdir(path, 0777) == 0 || errno == EEXIST)
+    if (f->type == DIST_NORMAL_REAL || f->type == DIST_NORMAL_INT)
     {
-        return 0;
+        *lo = f->mu - 4 * f->sigma;
+        *hi = f->mu + 4 * f->sigma;
     }
     else
     {
-        perror("Error creating directory");
-        return -1;
+        *lo = f->m;
+        *hi = f->M;
     }
+    if (dist_is_integer(f->type))
+    {
+        *lo = floor(*lo) - 0.5;
+        *hi = ceil(*hi) + 0.5;
+    }
+}
+
+// Histograms go to HISTOGRAM/<last folder component>, e.g. HISTOGRAM/Scenario1
+const char *histogram_folder(const char *folder)
+{
+    const char *name = strrchr(folder, '/');
+    return name != NULL ? name + 1 : folder;
 }
-void generate_random_numbers_to_file(const char *filename, int type, double m, double M, double mu, double sigma, int N)
+
+// Two different folders with the same last component would share a histogram folder
+int check_histogram_folders(const job_t *jobs, int njobs)
 {
-    FILE *file = fopen(filename, "w");
-    if (!file)
+    for (int a = 0; a < njobs; a++)
     {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
+        for (int b = 0; b < a; b++)
+        {
+            if (strcmp(jobs[a].folder, jobs[b].folder) != 0 &&
+                strcmp(histogram_folder(jobs[a].folder), histogram_folder(jobs[b].folder)) == 0)
+            {
+                fprintf(stderr, "%s and %s would both write their histograms to HISTOGRAM/%s\n", jobs[b].folder,
+                        jobs[a].folder, histogram_folder(jobs[a].folder));
+                return -1;
+            }
+        }
     }
+    return 0;
+}
 
-    for (int i = 0; i < N; i++)
+// Write statistics.txt (also echoed to the console) and the HISTOGRAM files
+int write_pipeline_results(const gen_file_t *files, const job_t *jobs, int njobs)
+{
+    text_writer_t w;
+    int rc = 0;
+    if (writer_open(&w, "statistics.txt") != 0)
     {
-        double num = 0;
-        switch (type)
+        perror("statistics.txt");
+        return -1;
+    }
+    for (int k = 0; k < njobs; k++)
+    {
+        const job_t *job = &jobs[k];
+        char line[512], path[512];
+
+        const char *name = histogram_folder(job->folder);
+        snprintf(path, sizeof(path), "HISTOGRAM/%s", name);
+        create_directory(path);
+
+        snprintf(line, sizeof(line), "%s%s\n%-28s%12s%16s%16s%16s%16s%12s%12s\n", k > 0 ? "\n" : "", job->folder,
+                 "File", "N", "Mean", "Stddev", "Min", "Max", "Skewness", "Kurtosis");
+        writer_put_str(&w, line);
+        for (int d = 0; d < job->ntypes; d++)
         {
-        case 1:
-            num = (int)(m + rand() % ((int)M - (int)m + 1));
-            break;
-        case 2:
-            num = m + frand() * (M - m);
-            break;
-        case 3:
-            num = mu + nrand() * sigma;
-            break;
-        default:
-            fprintf(stderr, "Invalid type\n");
-            exit(EXIT_FAILURE);
+            const gen_file_t *f = &files[job->first_file + d];
+            snprintf(line, sizeof(line), "%-28s%12lld%16.5f%16.5f%16.5f%16.5f%12.5f%12.5f\n", dist_file_name(f->type),
+                     (long long)f->N, stats_mean(f->stats), stats_stddev(f->stats), f->stats->min, f->stats->max,
+                     stats_skewness(f->stats), stats_kurtosis(f->stats));
+            writer_put_str(&w, line);
+        }
+
+        // Shape of each file: sketch quantiles, then the fit against its own distribution
+        snprintf(line, sizeof(line), "%-28s%12s%12s%12s%12s%12s%10s%10s%14s%8s%10s\n", "", "P01", "P25", "P50",
+                 "P75", "P99", "KS D", "KS p", "Chi2", "df", "Chi2 p");
+        writer_put_str(&w, line);
+        for (int d = 0; d < job->ntypes; d++)
+        {
+            const gen_file_t *f = &files[job->first_file + d];
+            static const double probs[5] = {0.01, 0.25, 0.5, 0.75, 0.99};
+            double q[5], ks = NAN, ks_p = NAN, chi2 = NAN, chi2_p = NAN;
+            int df = 0;
+            kll_quantiles(f->sketch, probs, q, 5);
+            if (f->gof != NULL)
+            {
+                ks = gof_ks(f->gof, &ks_p);
+                chi2 = gof_chi2(f->gof, &df, &chi2_p);
+            }
+            snprintf(line, sizeof(line), "%-28s%12.4f%12.4f%12.4f%12.4f%12.4f%10.6f%10.4f%14.2f%8d%10.4f\n",
+                     dist_file_name(f->type), q[0], q[1], q[2], q[3], q[4], ks, ks_p, chi2, df, chi2_p);
+            writer_put_str(&w, line);
         }
-        fprintf(file, "%.6f\n", num);
+
+        for (int d = 0; d < job->ntypes; d++)
+        {
+            const gen_file_t *f = &files[job->first_file + d];
+
+            text_writer_t hw;
+            snprintf(path, sizeof(path), "HISTOGRAM/%s/%s_histogram.txt", name, dist_file_name(f->type));
+            if (writer_open(&hw, path) != 0)
+            {
+                perror(path);
+                rc = -1;
+                continue;
+            }
+            hist_write(f->hist, &hw);
+            if (writer_close(&hw) != 0)
+            {
+                perror(path);
+                rc = -1;
+            }
+        }
+    }
+    if (writer_close(&w) != 0)
+    {
+        perror("statistics.txt");
+        return -1;
+    }
+
+    // Echo the summary to the console
+    FILE *in = fopen("statistics.txt", "r");
+    char buf[512];
+    while (in != NULL && fgets(buf, sizeof(buf), in) != NULL)
+    {
+        fputs(buf, stdout);
     }
-    fclose(file);
-}
\ No newline at end of file
+    if (in != NULL)
+    {
+        fclose(in);
+    }
+    return rc;
+}
+
+// Create path and any missing parent directories
+int create_directory(const char *path)
+{
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p != '\0'; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+            {
+                perror("Error creating directory");
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(dir, 0777) == 0 || errno == EEXIST)
+    {
+        return 0;
+    }
+    else
+    {
+        perror("Error creating directory");
+        return -1;
+    }
+}
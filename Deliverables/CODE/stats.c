@@ -0,0 +1,127 @@
+/******************************************************************************
+ * File: stats.c
+ *
+ * Purpose:
+ * Batch updates and merging for the running statistics in stats.h.
+ *
+ *****************************************************************************/
+#include <math.h>
+
+#include "stats.h"
+
+void stats_init(stats_acc_t *acc) {
+    acc->n = 0;
+    acc->mean = 0;
+    acc->m2 = 0;
+    acc->m3 = 0;
+    acc->m4 = 0;
+    acc->min = INFINITY;
+    acc->max = -INFINITY;
+}
+
+void stats_merge(stats_acc_t *into, const stats_acc_t *from) {
+    if (from->n == 0) {
+        return;
+    }
+    if (into->n == 0) {
+        *into = *from;
+        return;
+    }
+    double na = (double)into->n, nb = (double)from->n;
+    double n = na + nb;
+    double delta = from->mean - into->mean;
+    double delta2 = delta * delta;
+    double m2a = into->m2, m3a = into->m3;
+    into->mean += delta * (nb / n);
+    into->m2 += from->m2 + delta2 * (na * nb / n);
+    // Pebay (2008): the cross terms reuse the old m2/m3 of both sides
+    into->m3 += from->m3 + delta2 * delta * (na * nb * (na - nb) / (n * n)) +
+                3 * delta * (na * from->m2 - nb * m2a) / n;
+    into->m4 += from->m4 + delta2 * delta2 * (na * nb * (na * na - na * nb + nb * nb) / (n * n * n)) +
+                6 * delta2 * (na * na * from->m2 + nb * nb * m2a) / (n * n) +
+                4 * delta * (na * from->m3 - nb * m3a) / n;
+    into->n += from->n;
+    into->min = from->min < into->min ? from->min : into->min;
+    into->max = from->max > into->max ? from->max : into->max;
+}
+
+// Central moments of a block around its own mean, ready to be merged
+static void block_moments(stats_acc_t *block, double sum, size_t n) {
+    block->n = n;
+    block->mean = sum / (double)n;
+    block->m2 = 0;
+    block->m3 = 0;
+    block->m4 = 0;
+}
+
+void stats_push_batch(stats_acc_t *acc, const double *x, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    // Two passes over the block: exact-ish mean, then powers of the deviations
+    stats_acc_t block;
+    double sum = 0, lo = x[0], hi = x[0];
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i];
+        lo = x[i] < lo ? x[i] : lo;
+        hi = x[i] > hi ? x[i] : hi;
+    }
+    block_moments(&block, sum, n);
+    for (size_t i = 0; i < n; i++) {
+        double d = x[i] - block.mean;
+        double d2 = d * d;
+        block.m2 += d2;
+        block.m3 += d2 * d;
+        block.m4 += d2 * d2;
+    }
+    block.min = lo;
+    block.max = hi;
+    stats_merge(acc, &block);
+}
+
+void stats_push_batch_int(stats_acc_t *acc, const int *x, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    stats_acc_t block;
+    double sum = 0;
+    int lo = x[0], hi = x[0];
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i];
+        lo = x[i] < lo ? x[i] : lo;
+        hi = x[i] > hi ? x[i] : hi;
+    }
+    block_moments(&block, sum, n);
+    for (size_t i = 0; i < n; i++) {
+        double d = x[i] - block.mean;
+        double d2 = d * d;
+        block.m2 += d2;
+        block.m3 += d2 * d;
+        block.m4 += d2 * d2;
+    }
+    block.min = lo;
+    block.max = hi;
+    stats_merge(acc, &block);
+}
+
+double stats_mean(const stats_acc_t *acc) {
+    return acc->n > 0 ? acc->mean : NAN;
+}
+
+double stats_stddev(const stats_acc_t *acc) {
+    return acc->n > 1 ? sqrt(acc->m2 / (double)(acc->n - 1)) : NAN;
+}
+
+double stats_skewness(const stats_acc_t *acc) {
+    if (acc->n < 2 || !(acc->m2 > 0)) {
+        return NAN;
+    }
+    return sqrt((double)acc->n) * acc->m3 / pow(acc->m2, 1.5);
+}
+
+double stats_kurtosis(const stats_acc_t *acc) {
+    if (acc->n < 2 || !(acc->m2 > 0)) {
+        return NAN;
+    }
+    return (double)acc->n * acc->m4 / (acc->m2 * acc->m2) - 3;
+}
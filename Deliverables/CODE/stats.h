@@ -0,0 +1,67 @@
+/******************************************************************************
+ * File: stats.h
+ *
+ * Purpose:
+ * Single-pass running statistics in O(1) memory. Samples are folded into an
+ * accumulator as they are generated (Welford's update, extended to the third
+ * and fourth central moments), so no array of the samples is ever kept.
+ * Counts are 64-bit, and two accumulators can be merged exactly (Chan et al.
+ * for the mean and M2, Pebay for M3 and M4), so each thread can keep its own
+ * and combine them at the end.
+ *
+ * Batches are summarised with a two-pass mean and central moments over the
+ * block (which stays in cache) and then merged, which is both faster and
+ * more accurate than a long chain of single updates.
+ *
+ * Quantiles and goodness of fit live in kll.h and gof.h.
+ *
+ *****************************************************************************/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t n;
+    double mean;
+    double m2;       // Sums of the 2nd, 3rd and 4th powers of deviations from the mean
+    double m3;
+    double m4;
+    double min, max; // +inf / -inf while empty
+} stats_acc_t;
+
+// Start an empty accumulator
+void stats_init(stats_acc_t *acc);
+// Fold a block of samples into the accumulator
+void stats_push_batch(stats_acc_t *acc, const double *x, size_t n);
+void stats_push_batch_int(stats_acc_t *acc, const int *x, size_t n);
+// Add everything seen by from into into
+void stats_merge(stats_acc_t *into, const stats_acc_t *from);
+// Sample mean and sample standard deviation (N - 1 in the denominator)
+double stats_mean(const stats_acc_t *acc);
+double stats_stddev(const stats_acc_t *acc);
+// Sample skewness g1 = m3 / m2^1.5 and excess kurtosis g2 = m4 / m2^2 - 3
+// (moment estimators, N in the denominators)
+double stats_skewness(const stats_acc_t *acc);
+double stats_kurtosis(const stats_acc_t *acc);
+
+// Fold one sample into the accumulator (Welford, with Terriberry's update
+// of the higher moments)
+static inline void stats_push(stats_acc_t *acc, double x) {
+    double n1 = (double)acc->n;
+    acc->n++;
+    double n = (double)acc->n;
+    double delta = x - acc->mean;
+    double delta_n = delta / n;
+    double delta_n2 = delta_n * delta_n;
+    double term = delta * delta_n * n1;
+    acc->mean += delta_n;
+    acc->m4 += term * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * acc->m2 - 4 * delta_n * acc->m3;
+    acc->m3 += term * delta_n * (n - 2) - 3 * delta_n * acc->m2;
+    acc->m2 += term;
+    acc->min = x < acc->min ? x : acc->min;
+    acc->max = x > acc->max ? x : acc->max;
+}
+
+#endif
@@ -0,0 +1,338 @@
+/******************************************************************************
+ * File: textread.c
+ *
+ * Purpose:
+ * mmap reader, number parser and the threaded parse/scan drivers declared
+ * in textread.h.
+ *
+ *****************************************************************************/
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "textread.h"
+
+// Below this many bytes per thread, a chunk is not worth a thread
+#define TEXTREAD_MIN_CHUNK (1 << 20)
+// Values parsed per block before they are handed to stats/hist
+#define TEXTREAD_BLOCK 4096
+// Longest number handed to strtod (longer text is cut here)
+#define TEXTREAD_MAX_NUMBER 400
+
+// Powers of ten that are exact doubles
+static const double TEXTREAD_POW10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+typedef struct {
+    const char *begin, *end; // Newline-aligned slice of the file
+    long long lines;         // Upper bound on the values in the slice
+    double *out;             // Parse: room for lines values
+    long long count;         // Values found
+    stats_acc_t stats;       // Scan: values of this slice only
+    hist_t hist;
+} textread_part_t;
+
+int textread_map(const char *path, text_map_t *tm) {
+    struct stat st;
+    memset(tm, 0, sizeof *tm);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd); // Nothing to map; an empty file simply has no values
+        return 0;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    tm->data = map;
+    tm->size = (size_t)st.st_size;
+    tm->map = map;
+    return 0;
+}
+
+void textread_unmap(text_map_t *tm) {
+    if (tm->map != NULL) {
+        munmap(tm->map, tm->size);
+    }
+    memset(tm, 0, sizeof *tm);
+}
+
+// Slow path: copy the number into a NUL-terminated buffer for strtod
+static const char *textread_strtod(const char *p, const char *end, double *out) {
+    char buf[TEXTREAD_MAX_NUMBER + 1];
+    size_t n = 0;
+    while (p + n < end && n < TEXTREAD_MAX_NUMBER && p[n] != '\n') {
+        buf[n] = p[n];
+        n++;
+    }
+    buf[n] = '\0';
+    char *stop;
+    *out = strtod(buf, &stop);
+    return stop == buf ? NULL : p + (stop - buf);
+}
+
+const char *textread_number(const char *p, const char *end, double *out) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    const char *start = p;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p++ == '-';
+    }
+
+    uint64_t mant = 0;
+    int digits = 0, frac = 0, seen = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (mant != 0 || *p != '0') {
+            digits++;
+        }
+        mant = mant * 10 + (uint64_t)(*p - '0');
+        p++;
+        seen++;
+        if (digits > 19) {
+            return textread_strtod(start, end, out);
+        }
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (mant != 0 || *p != '0') {
+                digits++;
+            }
+            mant = mant * 10 + (uint64_t)(*p - '0');
+            p++;
+            frac++;
+            seen++;
+            if (digits > 19) {
+                return textread_strtod(start, end, out);
+            }
+        }
+    }
+    // Exponents, hex, inf/nan, no digits, or a mantissa or scale that is not exact
+    if (seen == 0 || (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X')) ||
+        mant > (UINT64_C(1) << 53) || frac > 22) {
+        return textread_strtod(start, end, out);
+    }
+    double x = (double)mant / TEXTREAD_POW10[frac];
+    *out = neg ? -x : x;
+    return p;
+}
+
+// Cut the file into up to threads newline-aligned slices; returns the count
+static int textread_split(const text_map_t *tm, int threads, textread_part_t *parts) {
+    size_t most = tm->size / TEXTREAD_MIN_CHUNK;
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > most) {
+        threads = most > 1 ? (int)most : 1;
+    }
+    const char *end = tm->data + tm->size;
+    const char *p = tm->data;
+    int n = 0;
+    for (int t = 0; t < threads && p < end; t++) {
+        const char *q = t == threads - 1 ? end : tm->data + tm->size * (size_t)(t + 1) / (size_t)threads;
+        if (q < p) {
+            q = p;
+        }
+        if (q < end) {
+            const char *nl = memchr(q, '\n', (size_t)(end - q));
+            q = nl != NULL ? nl + 1 : end;
+        }
+        memset(&parts[n], 0, sizeof parts[n]);
+        parts[n].begin = p;
+        parts[n].end = q;
+        n++;
+        p = q;
+    }
+    return n;
+}
+
+// Run fn on every part, the calling thread taking the first
+static void textread_run(textread_part_t *parts, int n, void *(*fn)(void *)) {
+    pthread_t tids[n > 1 ? n : 1];
+    int started = 1;
+    for (int t = 1; t < n; t++, started++) {
+        if (pthread_create(&tids[t], NULL, fn, &parts[t]) != 0) {
+            break;
+        }
+    }
+    fn(&parts[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    for (int t = started; t < n; t++) {
+        fn(&parts[t]);
+    }
+}
+
+static void *textread_count_lines(void *arg) {
+    textread_part_t *part = arg;
+    long long lines = 0;
+    const char *p = part->begin;
+    while (p < part->end) {
+        const char *nl = memchr(p, '\n', (size_t)(part->end - p));
+        lines++;
+        p = nl != NULL ? nl + 1 : part->end;
+    }
+    part->lines = lines;
+    return NULL;
+}
+
+static void *textread_parse_part(void *arg) {
+    textread_part_t *part = arg;
+    const char *p = part->begin, *end = part->end;
+    long long n = 0;
+    while (p < end) {
+        const char *q = textread_number(p, end, &part->out[n]);
+        if (q != NULL) {
+            n++;
+            p = q;
+        }
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl != NULL ? nl + 1 : end;
+    }
+    part->count = n;
+    return NULL;
+}
+
+long long textread_parse(const text_map_t *tm, double **out, int threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    textread_part_t *parts = malloc((size_t)threads * sizeof(textread_part_t));
+    if (parts == NULL) {
+        return -1;
+    }
+    int n = textread_split(tm, threads, parts);
+
+    // Count lines first so every slice parses straight into its place
+    if (n > 0) {
+        textread_run(parts, n, textread_count_lines);
+    }
+    long long lines = 0;
+    for (int t = 0; t < n; t++) {
+        lines += parts[t].lines;
+    }
+    double *vals = malloc((size_t)(lines > 0 ? lines : 1) * sizeof(double));
+    if (vals == NULL) {
+        free(parts);
+        return -1;
+    }
+    long long offset = 0;
+    for (int t = 0; t < n; t++) {
+        parts[t].out = vals + offset;
+        offset += parts[t].lines;
+    }
+    if (n > 0) {
+        textread_run(parts, n, textread_parse_part);
+    }
+
+    // Close the gaps left by skipped lines (none for generated files)
+    long long count = 0;
+    for (int t = 0; t < n; t++) {
+        if (parts[t].out != vals + count) {
+            memmove(vals + count, parts[t].out, (size_t)parts[t].count * sizeof(double));
+        }
+        count += parts[t].count;
+    }
+    free(parts);
+    *out = vals;
+    return count;
+}
+
+static void *textread_scan_part(void *arg) {
+    textread_part_t *part = arg;
+    const char *p = part->begin, *end = part->end;
+    double block[TEXTREAD_BLOCK];
+    int len = 0;
+    for (;;) {
+        if (len == TEXTREAD_BLOCK || (p >= end && len > 0)) {
+            stats_push_batch(&part->stats, block, (size_t)len);
+            if (part->hist.counts != NULL) {
+                hist_add_batch(&part->hist, block, (size_t)len);
+            }
+            part->count += len;
+            len = 0;
+        }
+        if (p >= end) {
+            break;
+        }
+        const char *q = textread_number(p, end, &block[len]);
+        if (q != NULL) {
+            len++;
+            p = q;
+        }
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl != NULL ? nl + 1 : end;
+    }
+    return NULL;
+}
+
+long long textread_scan(const text_map_t *tm, int threads, stats_acc_t *stats, hist_t *hist) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    textread_part_t *parts = malloc((size_t)threads * sizeof(textread_part_t));
+    uint64_t *counts = NULL;
+    if (parts == NULL) {
+        return -1;
+    }
+    int n = textread_split(tm, threads, parts);
+    // Private bins per slice, each starting on its own cache line
+    size_t stride = ((size_t)(hist != NULL ? hist->bins : 0) + 7) / 8 * 8;
+    if (hist != NULL && n > 0) {
+        counts = aligned_alloc(64, (size_t)n * stride * sizeof(uint64_t));
+        if (counts == NULL) {
+            free(parts);
+            return -1;
+        }
+        memset(counts, 0, (size_t)n * stride * sizeof(uint64_t));
+    }
+    for (int t = 0; t < n; t++) {
+        stats_init(&parts[t].stats);
+        if (hist != NULL) {
+            parts[t].hist = *hist;
+            parts[t].hist.counts = counts + (size_t)t * stride;
+            parts[t].hist.below = 0;
+            parts[t].hist.above = 0;
+        }
+    }
+    if (n > 0) {
+        textread_run(parts, n, textread_scan_part);
+    }
+
+    // Merge in file order
+    long long count = 0;
+    for (int t = 0; t < n; t++) {
+        if (stats != NULL) {
+            stats_merge(stats, &parts[t].stats);
+        }
+        if (hist != NULL) {
+            hist_merge(hist, &parts[t].hist);
+        }
+        count += parts[t].count;
+    }
+    free(counts);
+    free(parts);
+    return count;
+}
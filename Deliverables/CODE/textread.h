@@ -0,0 +1,45 @@
+/******************************************************************************
+ * File: textread.h
+ *
+ * Purpose:
+ * Fast reader for the DATA text files (one number per line). The file is
+ * mmap()ed, cut into newline-aligned chunks, and every chunk is parsed by
+ * its own thread with a hand-written number parser, so the cost is close to
+ * touching the bytes once.
+ *
+ * The parser returns exactly what strtod would: a number with at most 19
+ * significant digits, no exponent and at most 22 decimals is the exact
+ * integer mantissa divided by an exact power of ten (one correctly rounded
+ * IEEE division); anything else is handed to strtod.
+ *
+ * Like dataset_read_text, the first number of every line is taken and lines
+ * that do not start with a number are skipped.
+ *
+ *****************************************************************************/
+#ifndef TEXTREAD_H
+#define TEXTREAD_H
+
+#include <stddef.h>
+
+#include "hist.h"
+#include "stats.h"
+
+typedef struct {
+    const char *data; // File contents (not NUL-terminated)
+    size_t size;
+    void *map;
+} text_map_t;
+
+// mmap a text file read-only; 0 on success
+int textread_map(const char *path, text_map_t *tm);
+void textread_unmap(text_map_t *tm);
+// Parse every line into one contiguous array (*out, free() it); returns the count or -1
+long long textread_parse(const text_map_t *tm, double **out, int threads);
+// Stream every value into stats and/or hist (either may be NULL) without
+// keeping the values; returns the count or -1
+long long textread_scan(const text_map_t *tm, int threads, stats_acc_t *stats, hist_t *hist);
+// Parse the number at p (leading blanks allowed, must end before end);
+// returns the first byte after it, or NULL if p does not start with a number
+const char *textread_number(const char *p, const char *end, double *out);
+
+#endif
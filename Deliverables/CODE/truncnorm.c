@@ -0,0 +1,265 @@
+/******************************************************************************
+ * File: truncnorm.c
+ *
+ * Purpose:
+ * Strategy selection and sampling for the truncated normal (see truncnorm.h),
+ * plus the normal CDF/quantile helpers used by the inverse-CDF strategy.
+ *
+ *****************************************************************************/
+#include <math.h>
+
+#include "truncnorm.h"
+#include "alias.h"
+#include "instr.h"
+#include "normal.h"
+
+// Windows holding at least this much mass use plain rejection
+#define TRUNC_REJECT_MASS 0.3
+// Windows starting this many sigmas from mu use the exponential tail sampler
+#define TRUNC_TAIL_START 0.5
+// Reals drawn per pass of truncnorm_fill_int
+#define TRUNC_FILL_BLOCK 512
+
+double normal_cdf(double x) {
+    return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+// Acklam's rational approximation refined by one Halley step (~1e-15 relative)
+double normal_quantile(double p) {
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    const double p_low = 0.02425;
+    double q, r, x;
+
+    if (p <= 0) {
+        return -INFINITY;
+    }
+    if (p >= 1) {
+        return INFINITY;
+    }
+    if (p < p_low) {
+        q = sqrt(-2 * log(p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    } else if (p <= 1 - p_low) {
+        q = p - 0.5;
+        r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+    } else {
+        q = sqrt(-2 * log1p(-p));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+
+    // Halley refinement against the exact CDF
+    double e = normal_cdf(x) - p;
+    double u = e * sqrt(2 * 3.141592653589793238) * exp(x * x / 2);
+    return x - u / (1 + x * u / 2);
+}
+
+int truncnorm_init(truncnorm_t *tn, double mu, double sigma, double min, double max) {
+    if (!(sigma > 0) || !(min <= max)) {
+        return -1;
+    }
+    tn->mu = mu;
+    tn->sigma = sigma;
+    tn->a = (min - mu) / sigma;
+    tn->b = (max - mu) / sigma;
+    tn->mirrored = 0;
+    tn->alias = NULL;
+
+    // Keep the far side of the window on the right: [a, b] -> [-b, -a]
+    if (tn->b <= 0) {
+        double a = tn->a;
+        tn->a = -tn->b;
+        tn->b = -a;
+        tn->mirrored = 1;
+    }
+
+    double mass = tn->a >= 0 ? normal_cdf(-tn->a) - normal_cdf(-tn->b)
+                             : normal_cdf(tn->b) - normal_cdf(tn->a);
+    if (mass >= TRUNC_REJECT_MASS) {
+        tn->strategy = TRUNC_REJECT;
+    } else if (tn->a >= TRUNC_TAIL_START) {
+        // Robert's optimal rate for the one-sided tail
+        tn->strategy = TRUNC_TAIL;
+        tn->alpha = (tn->a + sqrt(tn->a * tn->a + 4)) / 2;
+        tn->tail_mass = -expm1(-tn->alpha * (tn->b - tn->a));
+        // Peak of the ratio target / proposal inside the window
+        double c = tn->alpha < tn->b ? tn->alpha : tn->b;
+        tn->accept_shift = (c - tn->alpha) * (c - tn->alpha);
+    } else {
+        tn->strategy = TRUNC_INVERSE;
+        tn->pa = normal_cdf(tn->a);
+        tn->pb = normal_cdf(tn->b);
+    }
+    return 0;
+}
+
+int truncnorm_init_int(truncnorm_t *tn, double mu, double sigma, int min, int max) {
+    if (truncnorm_init(tn, mu, sigma, min - 0.5, max + 0.5) != 0) {
+        return -1;
+    }
+    tn->min_int = min;
+    tn->max_int = max;
+    tn->alias = alias_get(mu, sigma, min, max);
+    return 0;
+}
+
+void truncnorm_free(truncnorm_t *tn) {
+    alias_release(tn->alias);
+    tn->alias = NULL;
+}
+
+double truncnorm_sample(const truncnorm_t *tn, rng_engine_t *eng) {
+    double z;
+
+    switch (tn->strategy) {
+    case TRUNC_REJECT: {
+        INSTR_LOCAL(tries);
+        do {
+            INSTR_INC(tries);
+            z = nrand(eng);
+        } while (z < tn->a || z > tn->b);
+        INSTR_ADD(INSTR_TRUNC_PROPOSALS, tries);
+        INSTR_ADD(INSTR_TRUNC_REJECTED, tries - 1);
+        break;
+    }
+    case TRUNC_TAIL:
+        for (;;) {
+            // Exponential proposal truncated to [a, b] by inversion
+            INSTR_ADD(INSTR_TAIL_PROPOSALS, 1);
+            z = tn->a - log1p(-frand(eng) * tn->tail_mass) / tn->alpha;
+            double d = z - tn->alpha;
+            if (frand(eng) <= exp(-0.5 * (d * d - tn->accept_shift))) {
+                break;
+            }
+            INSTR_ADD(INSTR_TAIL_REJECTED, 1);
+        }
+        break;
+    default:
+        z = normal_quantile(tn->pa + frand(eng) * (tn->pb - tn->pa));
+        break;
+    }
+    if (tn->mirrored) {
+        z = -z;
+    }
+    return tn->mu + z * tn->sigma;
+}
+
+int truncnorm_sample_int(const truncnorm_t *tn, rng_engine_t *eng) {
+    if (tn->alias != NULL) {
+        return alias_sample(tn->alias, eng);
+    }
+    int value = (int)round(truncnorm_sample(tn, eng));
+    // round() sends the exact upper edge max + 0.5 to max + 1
+    if (value < tn->min_int) {
+        value = tn->min_int;
+    } else if (value > tn->max_int) {
+        value = tn->max_int;
+    }
+    return value;
+}
+
+// One loop per strategy, written once and instantiated per engine with its
+// draw (NEXT) inlined. The results are exactly those of truncnorm_sample:
+// negating sigma instead of z is exact, and the draws come in the same order.
+#define TRUNCNORM_FILL_LOOPS(E, NEXT)                                                        \
+    static void fill_##E(const truncnorm_t *tn, rng_engine_t *eng, double *out, size_t n) { \
+        const double mu = tn->mu, a = tn->a, b = tn->b;                                      \
+        const double sigma = tn->mirrored ? -tn->sigma : tn->sigma;                          \
+        switch (tn->strategy) {                                                              \
+        case TRUNC_REJECT: {                                                                 \
+            INSTR_LOCAL(tries);                                                              \
+            for (size_t i = 0; i < n; i++) {                                                 \
+                double z;                                                                    \
+                do {                                                                         \
+                    INSTR_INC(tries);                                                        \
+                    z = normal_ziggurat_bits(eng, NEXT(eng));                                \
+                } while (z < a || z > b);                                                    \
+                out[i] = mu + z * sigma;                                                     \
+            }                                                                                \
+            INSTR_ADD(INSTR_TRUNC_PROPOSALS, tries);                                         \
+            INSTR_ADD(INSTR_TRUNC_REJECTED, tries - n);                                      \
+            break;                                                                           \
+        }                                                                                    \
+        case TRUNC_TAIL: {                                                                   \
+            const double alpha = tn->alpha, mass = tn->tail_mass, shift = tn->accept_shift;  \
+            INSTR_LOCAL(tries);                                                              \
+            for (size_t i = 0; i < n; i++) {                                                 \
+                double z;                                                                    \
+                for (;;) {                                                                   \
+                    INSTR_INC(tries);                                                        \
+                    z = a - log1p(-engine_bits_to_double(NEXT(eng)) * mass) / alpha;         \
+                    double d = z - alpha;                                                    \
+                    if (engine_bits_to_double(NEXT(eng)) <= exp(-0.5 * (d * d - shift))) {   \
+                        break;                                                               \
+                    }                                                                        \
+                }                                                                            \
+                out[i] = mu + z * sigma;                                                     \
+            }                                                                                \
+            INSTR_ADD(INSTR_TAIL_PROPOSALS, tries);                                          \
+            INSTR_ADD(INSTR_TAIL_REJECTED, tries - n);                                       \
+            break;                                                                           \
+        }                                                                                    \
+        default: {                                                                           \
+            const double pa = tn->pa, width = tn->pb - tn->pa;                               \
+            for (size_t i = 0; i < n; i++) {                                                 \
+                double z = normal_quantile(pa + engine_bits_to_double(NEXT(eng)) * width);   \
+                out[i] = mu + z * sigma;                                                     \
+            }                                                                                \
+            break;                                                                           \
+        }                                                                                    \
+        }                                                                                    \
+    }
+
+TRUNCNORM_FILL_LOOPS(xoshiro, engine_next_xoshiro)
+TRUNCNORM_FILL_LOOPS(philox, engine_next_philox)
+
+void truncnorm_fill(const truncnorm_t *tn, rng_engine_t *eng, double *out, size_t n) {
+    if (eng->normal_method == NORMAL_BOX_MULLER) {
+        // Box-Muller keeps its spare in the engine: stay on the generic path
+        for (size_t i = 0; i < n; i++) {
+            out[i] = truncnorm_sample(tn, eng);
+        }
+    } else if (eng->kind == ENGINE_XOSHIRO256PP) {
+        fill_xoshiro(tn, eng, out, n);
+    } else {
+        fill_philox(tn, eng, out, n);
+    }
+}
+
+void truncnorm_fill_int(const truncnorm_t *tn, rng_engine_t *eng, int *out, size_t n) {
+    if (tn->alias != NULL) {
+        alias_fill(tn->alias, eng, out, n);
+        return;
+    }
+    double x[TRUNC_FILL_BLOCK];
+    for (size_t done = 0; done < n; done += TRUNC_FILL_BLOCK) {
+        size_t len = n - done < TRUNC_FILL_BLOCK ? n - done : TRUNC_FILL_BLOCK;
+        truncnorm_fill(tn, eng, x, len);
+        for (size_t i = 0; i < len; i++) {
+            // Clamped as in truncnorm_sample_int
+            int value = (int)round(x[i]);
+            out[done + i] = value < tn->min_int ? tn->min_int : (value > tn->max_int ? tn->max_int : value);
+        }
+    }
+}
+
+const char *truncnorm_strategy_name(truncnorm_strategy_t strategy) {
+    switch (strategy) {
+    case TRUNC_REJECT:
+        return "rejection";
+    case TRUNC_TAIL:
+        return "tail";
+    default:
+        return "inverse-cdf";
+    }
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * File: truncnorm.h
+ *
+ * Purpose:
+ * Truncated normal sampler with bounded expected cost for any window
+ * [min, max]. The strategy is chosen once per window by truncnorm_init:
+ *
+ * 1. **Rejection**: the window holds at least 30% of the mass, so drawing
+ *    plain normals and rejecting takes fewer than 3.4 tries on average.
+ * 2. **Tail**: the window lies at least half a sigma to one side of mu.
+ *    Robert's (1995) exponential proposal, truncated to the window, is
+ *    accepted with probability >= ~0.6 however far out the window sits.
+ * 3. **Inverse CDF**: narrow windows near mu; one uniform and one call to
+ *    the normal quantile function, no rejection at all.
+ *
+ * The integer variant samples the real window [min - 0.5, max + 0.5] and
+ * rounds, which is exactly round(N(mu, sigma)) conditioned on [min, max].
+ * Windows of at most ALIAS_MAX_SIZE integers are instead drawn from a cached
+ * alias table of that same distribution (alias.h) in O(1).
+ *
+ *****************************************************************************/
+#ifndef TRUNCNORM_H
+#define TRUNCNORM_H
+
+#include <stddef.h>
+
+#include "engine.h"
+
+struct alias_table;
+
+typedef enum {
+    TRUNC_REJECT = 0,
+    TRUNC_TAIL = 1,
+    TRUNC_INVERSE = 2
+} truncnorm_strategy_t;
+
+typedef struct {
+    double mu, sigma;
+    double a, b;          // Standardised window, mirrored so that the tail is on the right
+    int mirrored;         // Window was left of mu: negate the standardised draw
+    truncnorm_strategy_t strategy;
+    double alpha;         // Tail: exponential rate of the proposal
+    double tail_mass;     // Tail: 1 - exp(-alpha * (b - a))
+    double accept_shift;  // Tail: (c - alpha)^2 for the acceptance ratio
+    double pa, pb;        // Inverse: Phi(a) and Phi(b)
+    int min_int, max_int; // Integer window (truncnorm_init_int only)
+    const struct alias_table *alias; // Integer window small enough to tabulate, else NULL
+} truncnorm_t;
+
+// Set up a sampler for N(mu, sigma) truncated to [min, max]; -1 if the window is empty
+int truncnorm_init(truncnorm_t *tn, double mu, double sigma, double min, double max);
+// Set up a sampler for round(N(mu, sigma)) truncated to the integers [min, max]
+int truncnorm_init_int(truncnorm_t *tn, double mu, double sigma, int min, int max);
+// Release the alias table truncnorm_init_int may hold
+void truncnorm_free(truncnorm_t *tn);
+// Draw one real value from the truncated normal
+double truncnorm_sample(const truncnorm_t *tn, rng_engine_t *eng);
+// Draw one integer value (tn must come from truncnorm_init_int)
+int truncnorm_sample_int(const truncnorm_t *tn, rng_engine_t *eng);
+// out[0..n) = n calls of truncnorm_sample, with the strategy and the engine
+// kind resolved once for the whole block
+void truncnorm_fill(const truncnorm_t *tn, rng_engine_t *eng, double *out, size_t n);
+// Same for truncnorm_sample_int
+void truncnorm_fill_int(const truncnorm_t *tn, rng_engine_t *eng, int *out, size_t n);
+// Standard normal CDF and its inverse
+double normal_cdf(double x);
+double normal_quantile(double p);
+// Human readable strategy name
+const char *truncnorm_strategy_name(truncnorm_strategy_t strategy);
+
+#endif
@@ -0,0 +1,432 @@
+/******************************************************************************
+ * File: writer.c
+ *
+ * Purpose:
+ * Number formatting and buffered write() output for writer.h, and the
+ * I/O thread of asynchronous writers.
+ *
+ *****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "instr.h"
+#include "writer.h"
+
+// Ring shared by a writer and its I/O thread. Buffers [head, tail) are full
+// and queued; the producer fills buffer tail and may move on while fewer
+// than WRITER_RING are outstanding.
+struct writer_async {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    char *bufs[WRITER_RING];
+    size_t lens[WRITER_RING];
+    unsigned head, tail;
+    int done;     // Producer has closed: drain and exit
+    int failed;   // A write failed on the I/O thread
+    int fd;
+#ifdef HAVE_LIBURING
+    int uring;    // Submit through ring (seekable fd and queue set up)
+    struct io_uring ring;
+    off_t offset; // File offset of the next buffer
+#endif
+};
+
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+static const uint64_t UPOW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// "00" .. "99", used to emit two digits at a time
+static const char DIGITS2[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write v in decimal right-aligned ending at end; returns the start
+static char *put_digits(char *end, uint64_t v) {
+    while (v >= 100) {
+        unsigned d = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--end = DIGITS2[d + 1];
+        *--end = DIGITS2[d];
+    }
+    if (v >= 10) {
+        *--end = DIGITS2[v * 2 + 1];
+        *--end = DIGITS2[v * 2];
+    } else {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+size_t fmt_int(char *dst, long long v) {
+    char tmp[24];
+    char *end = tmp + sizeof tmp;
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    char *start = put_digits(end, u);
+    size_t n = 0;
+    if (v < 0) {
+        dst[n++] = '-';
+    }
+    memcpy(dst + n, start, (size_t)(end - start));
+    return n + (size_t)(end - start);
+}
+
+size_t fmt_fixed(char *dst, double x, int prec) {
+    double ax = fabs(x);
+    double scaled = ax * POW10[prec];
+
+    // Fast path needs x * 10^prec exactly representable as an integer part
+    if (!(scaled < 1e15)) {
+        return (size_t)snprintf(dst, FMT_MAX, "%.*f", prec, x);
+    }
+
+    double whole = floor(scaled);
+    double frac = scaled - whole; // Exact: scaled < 2^53
+    // The multiply may be off by half an ulp; too close to .5 to decide -> snprintf
+    if (fabs(frac - 0.5) <= scaled * 0x1p-51 + 0x1p-60) {
+        return (size_t)snprintf(dst, FMT_MAX, "%.*f", prec, x);
+    }
+    uint64_t q = (uint64_t)whole + (frac > 0.5);
+
+    size_t n = 0;
+    if (signbit(x)) {
+        dst[n++] = '-'; // printf keeps the sign of values that round to zero
+    }
+    char tmp[24];
+    char *end = tmp + sizeof tmp;
+    char *start = put_digits(end, q / UPOW10[prec]);
+    memcpy(dst + n, start, (size_t)(end - start));
+    n += (size_t)(end - start);
+    if (prec > 0) {
+        uint64_t f = q % UPOW10[prec];
+        dst[n++] = '.';
+        for (int i = prec - 1; i >= 0; i--) {
+            dst[n + (size_t)i] = (char)('0' + f % 10);
+            f /= 10;
+        }
+        n += (size_t)prec;
+    }
+    return n;
+}
+
+int write_all(int fd, const char *s, size_t n) {
+    size_t off = 0;
+    INSTR_TIME_START(t0);
+    while (off < n) {
+        ssize_t r = write(fd, s + off, n - off);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        off += (size_t)r;
+    }
+    INSTR_TIME_STOP(t0, INSTR_WRITE);
+    INSTR_LATENCY(instr_now() - t0);
+    INSTR_ADD(INSTR_BYTES_WRITTEN, n);
+    return 0;
+}
+
+#ifdef HAVE_LIBURING
+// pwrite() all n bytes at off, retrying short writes; -1 on error
+static int pwrite_all(int fd, const char *s, size_t n, off_t off) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = pwrite(fd, s + done, n - done, off + (off_t)done);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)r;
+    }
+    return 0;
+}
+
+// Write buffers [head, tail) with one submission; -1 if any failed
+static int uring_write(writer_async_t *a, unsigned head, unsigned tail) {
+    off_t offsets[WRITER_RING];
+    INSTR_TIME_START(t0);
+    for (unsigned k = head; k != tail; k++) {
+        unsigned slot = k % WRITER_RING;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&a->ring);
+        offsets[slot] = a->offset;
+        io_uring_prep_write(sqe, a->fd, a->bufs[slot], (unsigned)a->lens[slot], (__u64)a->offset);
+        io_uring_sqe_set_data(sqe, (void *)(uintptr_t)slot);
+        a->offset += (off_t)a->lens[slot];
+    }
+    int rc = io_uring_submit(&a->ring) == (int)(tail - head) ? 0 : -1;
+    for (unsigned k = head; k != tail && rc == 0; k++) {
+        struct io_uring_cqe *cqe;
+        if (io_uring_wait_cqe(&a->ring, &cqe) != 0) {
+            return -1;
+        }
+        unsigned slot = (unsigned)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&a->ring, cqe);
+        // Short writes are finished synchronously
+        if (res < 0 || pwrite_all(a->fd, a->bufs[slot] + res, a->lens[slot] - (size_t)res,
+                                  offsets[slot] + res) != 0) {
+            rc = -1;
+        }
+        // Each buffer's latency runs from the submission to its completion
+        INSTR_LATENCY(instr_now() - t0);
+        INSTR_ADD(INSTR_BYTES_WRITTEN, a->lens[slot]);
+    }
+    INSTR_TIME_STOP(t0, INSTR_WRITE);
+    return rc;
+}
+#endif
+
+static void *writer_io_thread(void *arg) {
+    writer_async_t *a = arg;
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        while (a->head == a->tail && !a->done) {
+            pthread_cond_wait(&a->changed, &a->lock);
+        }
+        if (a->head == a->tail) {
+            break;
+        }
+        unsigned head = a->head, tail = a->tail;
+        int failed = a->failed;
+        pthread_mutex_unlock(&a->lock);
+
+        int rc = 0;
+#ifdef HAVE_LIBURING
+        if (a->uring && !failed) {
+            rc = uring_write(a, head, tail);
+        } else
+#endif
+        {
+            tail = head + 1; // One at a time, so each buffer goes back as soon as it is out
+            rc = failed ? 0 : write_all(a->fd, a->bufs[head % WRITER_RING], a->lens[head % WRITER_RING]);
+        }
+
+        pthread_mutex_lock(&a->lock);
+        a->failed |= rc != 0;
+        a->head = tail;
+        pthread_cond_broadcast(&a->changed);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return NULL;
+}
+
+// Queue the writer's buffer and wait for a free one
+static void async_flush(text_writer_t *w) {
+    writer_async_t *a = w->async;
+    pthread_mutex_lock(&a->lock);
+    a->lens[a->tail % WRITER_RING] = w->len;
+    a->tail++;
+    pthread_cond_broadcast(&a->changed);
+    INSTR_TIME_START(t0);
+    while (a->tail - a->head == WRITER_RING) {
+        pthread_cond_wait(&a->changed, &a->lock);
+    }
+    INSTR_TIME_STOP(t0, INSTR_WRITER_STALL);
+    w->failed |= a->failed;
+    pthread_mutex_unlock(&a->lock);
+    w->buf = a->bufs[a->tail % WRITER_RING];
+}
+
+// Drain the ring, stop the thread and hand the writer a single buffer back
+static void async_stop(text_writer_t *w) {
+    writer_async_t *a = w->async;
+    pthread_mutex_lock(&a->lock);
+    a->done = 1;
+    pthread_cond_broadcast(&a->changed);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->thread, NULL);
+    w->failed |= a->failed;
+#ifdef HAVE_LIBURING
+    if (a->uring) {
+        io_uring_queue_exit(&a->ring);
+        lseek(a->fd, a->offset, SEEK_SET); // Explicit offsets leave the file position behind
+    }
+#endif
+    for (int i = 0; i < WRITER_RING; i++) {
+        if (a->bufs[i] != w->buf) {
+            free(a->bufs[i]);
+        }
+    }
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->changed);
+    free(a);
+    w->async = NULL;
+}
+
+int writer_start_async(text_writer_t *w) {
+    if (w->async != NULL) {
+        return 0;
+    }
+    writer_async_t *a = calloc(1, sizeof *a);
+    if (a == NULL) {
+        return -1;
+    }
+    a->fd = w->fd;
+    a->bufs[0] = w->buf; // Whatever is buffered already goes out first
+    for (int i = 1; i < WRITER_RING; i++) {
+        a->bufs[i] = malloc(WRITER_BUFFER);
+        if (a->bufs[i] == NULL) {
+            while (--i > 0) {
+                free(a->bufs[i]);
+            }
+            free(a);
+            return -1;
+        }
+    }
+#ifdef HAVE_LIBURING
+    a->offset = lseek(w->fd, 0, SEEK_CUR);
+    a->uring = a->offset >= 0 && io_uring_queue_init(WRITER_RING, &a->ring, 0) == 0;
+#endif
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->changed, NULL);
+    if (pthread_create(&a->thread, NULL, writer_io_thread, a) != 0) {
+#ifdef HAVE_LIBURING
+        if (a->uring) {
+            io_uring_queue_exit(&a->ring);
+        }
+#endif
+        pthread_mutex_destroy(&a->lock);
+        pthread_cond_destroy(&a->changed);
+        for (int i = 1; i < WRITER_RING; i++) {
+            free(a->bufs[i]);
+        }
+        free(a);
+        return -1;
+    }
+    w->async = a;
+    return 0;
+}
+
+int writer_attach(text_writer_t *w, int fd) {
+    w->fd = fd;
+    w->owns_fd = 0;
+    w->len = 0;
+    w->failed = 0;
+    w->async = NULL;
+    w->buf = malloc(WRITER_BUFFER);
+    return w->buf != NULL ? 0 : -1;
+}
+
+int writer_open(text_writer_t *w, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return -1;
+    }
+    if (writer_attach(w, fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    w->owns_fd = 1;
+    return 0;
+}
+
+void writer_flush(text_writer_t *w) {
+    if (w->async != NULL) {
+        if (w->len > 0) {
+            async_flush(w);
+        }
+    } else if (w->len > 0 && !w->failed && write_all(w->fd, w->buf, w->len) != 0) {
+        w->failed = 1;
+    }
+    w->len = 0;
+}
+
+int writer_sync(text_writer_t *w) {
+    writer_flush(w);
+    if (w->async != NULL) {
+        writer_async_t *a = w->async;
+        pthread_mutex_lock(&a->lock);
+        while (a->head != a->tail) {
+            pthread_cond_wait(&a->changed, &a->lock);
+        }
+        w->failed |= a->failed;
+        pthread_mutex_unlock(&a->lock);
+    }
+    if (!w->failed && fdatasync(w->fd) != 0) {
+        w->failed = 1;
+    }
+    return w->failed ? -1 : 0;
+}
+
+int writer_close(text_writer_t *w) {
+    writer_flush(w);
+    if (w->async != NULL) {
+        async_stop(w);
+    }
+    free(w->buf);
+    w->buf = NULL;
+    if (w->owns_fd && close(w->fd) != 0) {
+        w->failed = 1;
+    }
+    return w->failed ? -1 : 0;
+}
+
+void writer_put(text_writer_t *w, const char *s, size_t n) {
+    if (n > WRITER_BUFFER && w->async != NULL) {
+        // Too big to buffer: pass it through the ring a buffer at a time
+        for (size_t off = 0; off < n; off += WRITER_BUFFER) {
+            writer_put(w, s + off, n - off < WRITER_BUFFER ? n - off : WRITER_BUFFER);
+        }
+        return;
+    }
+    if (n > WRITER_BUFFER) {
+        // Too big to buffer: write it straight through
+        writer_flush(w);
+        if (!w->failed && write_all(w->fd, s, n) != 0) {
+            w->failed = 1;
+        }
+        return;
+    }
+    writer_reserve(w, n);
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+void writer_put_str(text_writer_t *w, const char *s) {
+    writer_put(w, s, strlen(s));
+}
+
+void writer_put_fixed(text_writer_t *w, double x, int prec) {
+    writer_reserve(w, FMT_MAX);
+    w->len += fmt_fixed(w->buf + w->len, x, prec);
+}
+
+void writer_put_int(text_writer_t *w, long long v) {
+    writer_reserve(w, FMT_MAX);
+    w->len += fmt_int(w->buf + w->len, v);
+}
+
+// Pad the field that started at buffer offset start out to width
+static void pad_field(text_writer_t *w, size_t start, int width) {
+    while (w->len < start + (size_t)width) {
+        w->buf[w->len++] = ' ';
+    }
+}
+
+void writer_put_fixed_padded(text_writer_t *w, double x, int prec, int width) {
+    writer_reserve(w, FMT_MAX + (size_t)width);
+    size_t start = w->len;
+    w->len += fmt_fixed(w->buf + w->len, x, prec);
+    pad_field(w, start, width);
+}
+
+void writer_put_int_padded(text_writer_t *w, long long v, int width) {
+    writer_reserve(w, FMT_MAX + (size_t)width);
+    size_t start = w->len;
+    w->len += fmt_int(w->buf + w->len, v);
+    pad_field(w, start, width);
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * File: writer.h
+ *
+ * Purpose:
+ * Fast text output for the data files. Numbers are converted by hand into a
+ * large user-space buffer which is flushed with a few big write() calls, in
+ * place of one fprintf per sample.
+ *
+ * fmt_fixed(x, prec) produces exactly the bytes of printf("%.*f", prec, x):
+ * the common case is an integer conversion of x * 10^prec, and the rare
+ * values that land too close to a rounding tie (or are too large, NaN or
+ * infinite) are handed to snprintf.
+ *
+ * writer_start_async moves the write() calls to a dedicated I/O thread. The
+ * writer then owns a ring of WRITER_RING buffers: a flush queues the full
+ * buffer for the thread and carries on in the next free one, so formatting
+ * only waits for the disk when every buffer is queued. With liburing
+ * (HAVE_LIBURING) all queued buffers of a seekable file are submitted to
+ * io_uring together; otherwise, and for pipes and terminals, the thread
+ * uses plain write().
+ *
+ *****************************************************************************/
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+
+// Bytes buffered before a write() (1 MiB)
+#define WRITER_BUFFER (1 << 20)
+// Largest output of one fmt_fixed/fmt_int call
+#define FMT_MAX 350
+// Buffers of an asynchronous writer (one being filled, the rest queued)
+#define WRITER_RING 4
+
+typedef struct writer_async writer_async_t;
+
+typedef struct {
+    int fd;
+    int owns_fd;  // Close fd in writer_close
+    char *buf;
+    size_t len;
+    int failed;   // A write() failed; later output is dropped
+    writer_async_t *async; // I/O thread after writer_start_async, else NULL
+} text_writer_t;
+
+// Format x like "%.<prec>f" (prec 0..9) into dst; returns the length
+size_t fmt_fixed(char *dst, double x, int prec);
+// Format v like "%lld" into dst; returns the length
+size_t fmt_int(char *dst, long long v);
+
+// write() all n bytes, retrying short writes; -1 on error
+int write_all(int fd, const char *s, size_t n);
+
+// Create/truncate path and write to it; -1 on error
+int writer_open(text_writer_t *w, const char *path);
+// Write to an already open descriptor (e.g. STDOUT_FILENO)
+int writer_attach(text_writer_t *w, int fd);
+// Hand all further flushes to an I/O thread; -1 (and still synchronous) on error
+int writer_start_async(text_writer_t *w);
+// Push the buffered bytes to the descriptor (queue them, if asynchronous)
+void writer_flush(text_writer_t *w);
+// Flush, wait until the I/O thread has written everything queued and
+// fdatasync the file, so that all bytes put so far survive a crash; -1 if
+// any write failed
+int writer_sync(text_writer_t *w);
+// Flush, wait for the I/O thread, release the buffers and close the file;
+// -1 if any write failed
+int writer_close(text_writer_t *w);
+// Append raw bytes
+void writer_put(text_writer_t *w, const char *s, size_t n);
+void writer_put_str(text_writer_t *w, const char *s);
+// Append a number ("%.<prec>f" / "%lld")
+void writer_put_fixed(text_writer_t *w, double x, int prec);
+void writer_put_int(text_writer_t *w, long long v);
+// Same, left-justified and space-padded to width ("%-<width>.<prec>f" / "%-<width>d")
+void writer_put_fixed_padded(text_writer_t *w, double x, int prec, int width);
+void writer_put_int_padded(text_writer_t *w, long long v, int width);
+
+// Make room for n more bytes (flushing if needed)
+static inline void writer_reserve(text_writer_t *w, size_t n) {
+    if (w->len + n > WRITER_BUFFER) {
+        writer_flush(w);
+    }
+}
+
+static inline void writer_put_char(text_writer_t *w, char c) {
+    writer_reserve(w, 1);
+    w->buf[w->len++] = c;
+}
+
+#endif